@@ -1,19 +1,30 @@
-#pragma once
-#include <glad/glad.h>
-#include <string>
-#include <glm/mat4x2.hpp>
-
-GLuint setup_shaders();
-
-class shaders
-{
-	GLuint shader_id_;
-	static std::string read_shader(const char*);
-public:
-	shaders(const char*, const char*);
-	void use() const;
-	GLuint get_id() const;
-	void feed_mat(const char*, glm::mat4) const;
-	void feed_vec(const char*, glm::vec3) const;
-	void feed_float(const char*, float) const;
+#pragma once
+#include <glad/glad.h>
+#include <string>
+#include <unordered_map>
+#include <glm/mat3x3.hpp>
+#include <glm/mat4x2.hpp>
+
+GLuint setup_shaders();
+
+class shaders
+{
+	GLuint shader_id_;
+	// every active uniform, resolved once after linking
+	std::unordered_map<std::string, GLint> locations_;
+	static std::string read_shader(const char*);
+	void find_uniforms();
+public:
+	shaders(const char*, const char*);
+	void use() const;
+	GLuint get_id() const;
+	GLint get_location(const char*) const;
+	void bind_block(const char*, GLuint) const;
+	void feed_mat(const char*, glm::mat4) const;
+	void feed_vec(const char*, glm::vec3) const;
+	void feed_float(const char*, float) const;
+	void feed_mat(GLint, glm::mat4) const;
+	void feed_mat(GLint, glm::mat3) const;
+	void feed_vec(GLint, glm::vec3) const;
+	void feed_float(GLint, float) const;
 };
\ No newline at end of file
@@ -0,0 +1,70 @@
+// Progressive view of a scene that holds still: every refine() traces one more sample per pixel into running sums and the
+// image shows their average, so the picture keeps getting cleaner for as long as nothing moves. The scene's version tells
+// when the camera, the lamp or a shape has moved, and only then are the sums thrown away.
+#ifndef ACCUMULATOR_H
+#define ACCUMULATOR_H
+
+#include <../src/scene.cpp>
+#include <../src/tracer.cpp>
+#include <vector>
+
+class accumulator
+{
+	image frame_;
+	std::vector<vec3> sums_;
+	int samples_;
+	// no more samples are traced once every pixel has this many
+	int max_samples_;
+	// the scene's version the sums were traced from
+	unsigned long long version_;
+	bool started_;
+
+public:
+	accumulator(const int width, const int height, const int max_samples)
+		: frame_(width, height), sums_(size_t(width) * height), samples_(0), max_samples_(max_samples), version_(0), started_(false)
+	{
+	}
+
+	accumulator(const accumulator&) = delete;
+	accumulator& operator=(const accumulator&) = delete;
+
+	// starts over when the scene has changed since the last call, then traces one more sample per pixel; returns whether the
+	// image changed, which it no longer does once max_samples is reached, so a still view stops costing anything
+	bool refine(const scene* world, tracer* renderer, const unsigned threads = 0)
+	{
+		PROFILE_SCOPE("refine");
+		const auto version = world->get_version();
+		if (!this->started_ || version != this->version_)
+		{
+			renderer->update();
+			std::fill(this->sums_.begin(), this->sums_.end(), vec3(0.0f));
+			this->samples_ = 0;
+			this->version_ = version;
+			this->started_ = true;
+		}
+		if (this->samples_ >= this->max_samples_)
+		{
+			return false;
+		}
+		renderer->render_pass(&this->frame_, this->sums_.data(), this->samples_, this->samples_ + 1, threads);
+		this->samples_++;
+		return true;
+	}
+
+	bool is_converged() const
+	{
+		return this->started_ && this->samples_ >= this->max_samples_;
+	}
+
+	// samples per pixel behind the current image
+	int get_samples() const
+	{
+		return this->samples_;
+	}
+
+	const image* get_image() const
+	{
+		return &this->frame_;
+	}
+};
+#endif
@@ -0,0 +1,137 @@
+// Bump allocator: memory is handed out by moving an offset through large blocks and given back all at once. A scene keeps one
+// for its shapes and materials for as long as it lives; the renderers keep one per worker that is reset every tile, so once
+// the first frame has grown them rendering no longer calls malloc, and threads never meet in the heap's locks.
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+class arena
+{
+	struct block
+	{
+		std::unique_ptr<unsigned char[]> data;
+		size_t size;
+	};
+
+	// destructor of an object made here, run newest first
+	struct cleanup
+	{
+		void (*destroy)(void*);
+		void* item;
+	};
+
+	std::vector<block> blocks_;
+	std::vector<cleanup> cleanups_;
+	size_t block_size_;
+	// the block being carved up and how much of it is taken
+	size_t current_;
+	size_t used_;
+
+	template <typename item>
+	static void destroy(void* address)
+	{
+		static_cast<item*>(address)->~item();
+	}
+
+	void destroy_all()
+	{
+		for (auto entry = this->cleanups_.rbegin(); entry != this->cleanups_.rend(); ++entry)
+		{
+			entry->destroy(entry->item);
+		}
+		this->cleanups_.clear();
+	}
+
+public:
+	explicit arena(const size_t block_size = 64 * 1024) : block_size_(block_size), current_(0), used_(0) {}
+
+	arena(const arena&) = delete;
+	arena& operator=(const arena&) = delete;
+
+	// alignment must be a power of two
+	void* allocate(const size_t bytes, const size_t alignment = alignof(std::max_align_t))
+	{
+		for (; this->current_ < this->blocks_.size(); this->current_++, this->used_ = 0)
+		{
+			const auto& current = this->blocks_[this->current_];
+			const auto base = reinterpret_cast<uintptr_t>(current.data.get());
+			const auto start = (base + this->used_ + alignment - 1) & ~(uintptr_t(alignment) - 1);
+			if (start + bytes <= base + current.size)
+			{
+				this->used_ = start + bytes - base;
+				return reinterpret_cast<void*>(start);
+			}
+		}
+		// room for the worst case alignment, so the retry always fits
+		const auto size = std::max(this->block_size_, bytes + alignment);
+		this->blocks_.push_back(block{ std::unique_ptr<unsigned char[]>(new unsigned char[size]), size });
+		this->current_ = this->blocks_.size() - 1;
+		this->used_ = 0;
+		return this->allocate(bytes, alignment);
+	}
+
+	// destroyed by reset() or with the arena
+	template <typename item, typename... arguments>
+	item* make(arguments&&... values)
+	{
+		const auto made = new (this->allocate(sizeof(item), alignof(item))) item(std::forward<arguments>(values)...);
+		if (!std::is_trivially_destructible<item>::value)
+		{
+			this->cleanups_.push_back(cleanup{ &destroy<item>, made });
+		}
+		return made;
+	}
+
+	// count copies of value
+	template <typename item>
+	item* make_array(const size_t count, const item& value)
+	{
+		static_assert(std::is_trivially_destructible<item>::value, "arena arrays are never destroyed");
+		const auto items = static_cast<item*>(this->allocate(sizeof(item) * count, alignof(item)));
+		std::uninitialized_fill_n(items, count, value);
+		return items;
+	}
+
+	// destroys everything made so far and hands the same memory out again; when the last round needed more than one block
+	// they are merged, so a round of the same size fits without allocating
+	void reset()
+	{
+		this->destroy_all();
+		if (this->blocks_.size() > 1)
+		{
+			auto total = size_t(0);
+			for (const auto& entry : this->blocks_)
+			{
+				total += entry.size;
+			}
+			this->blocks_.clear();
+			this->blocks_.push_back(block{ std::unique_ptr<unsigned char[]>(new unsigned char[total]), total });
+		}
+		this->current_ = 0;
+		this->used_ = 0;
+	}
+
+	size_t get_memory_usage() const
+	{
+		auto bytes = this->cleanups_.capacity() * sizeof(cleanup);
+		for (const auto& entry : this->blocks_)
+		{
+			bytes += entry.size;
+		}
+		return bytes;
+	}
+
+	~arena()
+	{
+		this->destroy_all();
+	}
+};
+#endif
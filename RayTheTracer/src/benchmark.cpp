@@ -0,0 +1,392 @@
+// Fixed scenes timed the same way on every machine, reported as JSON. Every figure is the best of benchmark_runs runs,
+// ray rates use all render threads: primary rays from the camera, shadow rays from every hit towards the lamp and
+// secondary rays bounced off every hit in a cosine weighted direction.
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+#include <../src/scene.cpp>
+#include <../src/tracer.cpp>
+#include <../src/scene_file.cpp>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#include <psapi.h>
+#pragma comment(lib, "psapi.lib")
+#else
+#include <sys/resource.h>
+#endif
+
+const int benchmark_runs = 3;
+
+struct benchmark_result
+{
+	std::string name;
+	int triangles;
+	int instances;
+	int spheres;
+	int width;
+	int height;
+	// time to read the scene file, 0 for the built in scenes
+	double load_ms;
+	double build_ms;
+	// update() after every shape has moved a little
+	double refit_ms;
+	double primary_rays_per_second;
+	double shadow_rays_per_second;
+	double secondary_rays_per_second;
+	double frame_ms;
+	// the same frame through the wavefront renderer
+	double wavefront_frame_ms;
+	size_t structure_bytes;
+	// high water mark of the whole process once this scene is done, so it includes every scene run before it and never
+	// goes down from one scene to the next
+	size_t process_peak_memory_bytes;
+};
+
+// high water mark of the whole process so far
+inline size_t peak_memory()
+{
+#if defined(_WIN32)
+	PROCESS_MEMORY_COUNTERS counters;
+	if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+	{
+		return size_t(counters.PeakWorkingSetSize);
+	}
+	return 0;
+#else
+	struct rusage usage;
+	if (getrusage(RUSAGE_SELF, &usage) != 0)
+	{
+		return 0;
+	}
+#if defined(__APPLE__)
+	return size_t(usage.ru_maxrss);
+#else
+	return size_t(usage.ru_maxrss) * 1024;
+#endif
+#endif
+}
+
+// milliseconds of the fastest of benchmark_runs calls
+template <typename work>
+double best_time(work run)
+{
+	auto best = 1e300;
+	for (auto i = 0; i < benchmark_runs; i++)
+	{
+		const auto start = std::chrono::steady_clock::now();
+		run();
+		const auto elapsed = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+		best = std::min(best, elapsed);
+	}
+	return best;
+}
+
+// one gold or grey ball on every point of a 16x16x16 grid inside the box
+inline scene* many_spheres()
+{
+	const auto world = open_box();
+	const auto gold = world->add<material>(0.5f, 0.0f, 0.5f, vec3(1.0f, 0.83f, 0.3f));
+	const auto grey = world->add<material>(0.5f, 0.0f, 0.5f, vec3(0.5f, 0.5f, 0.5f));
+	const auto count = 16;
+	const auto spacing = 2.6f / count;
+	for (auto x = 0; x < count; x++)
+	{
+		for (auto y = 0; y < count; y++)
+		{
+			for (auto z = 0; z < count; z++)
+			{
+				const auto ball = world->add<sphere>((x + y + z) % 2 == 0 ? gold : grey, 16);
+				ball->translate(vec3(-1.3f + (x + 0.5f) * spacing, 0.2f + (y + 0.5f) * spacing, -1.3f + (z + 0.5f) * spacing));
+				ball->scale(vec3(0.3f * spacing));
+			}
+		}
+	}
+	add_walls(world);
+	return world;
+}
+
+// a finely tessellated ellipsoid, stretched so it stays a mesh instead of becoming an analytic sphere (about half a million triangles)
+inline scene* large_mesh()
+{
+	const auto world = open_box();
+	const auto gold = world->add<material>(0.5f, 0.0f, 0.5f, vec3(1.0f, 0.83f, 0.3f));
+	const auto blob = world->add<sphere>(gold, 512);
+	blob->translate(vec3(0.0f, 1.8f, -0.6f));
+	blob->scale(vec3(1.0f, 0.7f, 0.8f));
+	add_walls(world);
+	return world;
+}
+
+// the primary hit of every pixel centre, surface is null where the camera ray escapes
+inline void cast_primary(const tracer* renderer, tile_scheduler& scheduler, const int width, const int height, const unsigned threads, std::vector<intersection>& hits, std::vector<ray>& rays)
+{
+	scheduler.run(threads, [&](const tile& region, unsigned)
+	{
+		for (auto y = region.y; y < region.y + region.height; y++)
+		{
+			for (auto x = region.x; x < region.x + region.width; x++)
+			{
+				const auto index = y * width + x;
+				rays[index] = renderer->camera_ray((x + 0.5f) / width, (y + 0.5f) / height);
+				hits[index] = intersection();
+				renderer->intersect(rays[index], hits[index]);
+			}
+		}
+	});
+}
+
+// the direction the index-th secondary ray leaves a hit in, cosine weighted about the side of the normal the ray came from
+inline vec3 bounce_direction(const ray& incoming, const intersection& hit, const unsigned index)
+{
+	const auto normal = dot(hit.normal, incoming.direction) > 0.0f ? -hit.normal : hit.normal;
+	const auto first = (index * 2654435761u) ^ 0x9e3779b9u;
+	const auto second = first * 1664525u + 1013904223u;
+	const auto radius = sqrt(float(first >> 8) / 16777216.0f);
+	const auto angle = 2.0f * glm::pi<float>() * float(second >> 8) / 16777216.0f;
+	const auto tangent = normalize(std::abs(normal.x) > 0.5f ? cross(normal, vec3(0.0f, 1.0f, 0.0f)) : cross(normal, vec3(1.0f, 0.0f, 0.0f)));
+	const auto bitangent = cross(normal, tangent);
+	return normalize(radius * cos(angle) * tangent + radius * sin(angle) * bitangent + sqrt(max(0.0f, 1.0f - radius * radius)) * normal);
+}
+
+inline benchmark_result run_benchmark(const std::string& name, const scene* world, const int width, const int height, const unsigned threads)
+{
+	auto result = benchmark_result();
+	result.load_ms = 0.0;
+	result.name = name;
+	result.width = width;
+	result.height = height;
+
+	tracer* renderer = nullptr;
+	result.build_ms = best_time([&]()
+	{
+		delete renderer;
+		renderer = new tracer(world->cam, world->projection_plane, world->lamp);
+		for (auto item : world->shapes)
+		{
+			renderer->add(item);
+		}
+		renderer->build();
+	});
+	result.triangles = renderer->get_triangle_count();
+	result.instances = renderer->get_instance_count();
+	result.spheres = renderer->get_sphere_count();
+	result.structure_bytes = renderer->get_memory_usage();
+
+	// shapes step back and forth, so they end where they started after an even number of steps
+	auto steps = 0;
+	const auto step = [&]()
+	{
+		const auto offset = vec3(steps++ % 2 == 0 ? 0.01f : -0.01f, 0.0f, 0.0f);
+		for (auto item : world->shapes)
+		{
+			item->translate(offset);
+		}
+		renderer->update();
+	};
+	result.refit_ms = best_time(step);
+	if (steps % 2 != 0)
+	{
+		step();
+	}
+
+	auto scheduler = tile_scheduler(width, height);
+	const auto pixels = size_t(width) * height;
+	auto hits = std::vector<intersection>(pixels);
+	auto rays = std::vector<ray>(pixels, ray(vec3(0.0f), vec3(0.0f, 1.0f, 0.0f)));
+	const auto primary_ms = best_time([&]() { cast_primary(renderer, scheduler, width, height, threads, hits, rays); });
+	result.primary_rays_per_second = pixels / (primary_ms / 1000.0);
+
+	auto surface_hits = size_t(0);
+	for (const auto& hit : hits)
+	{
+		surface_hits += hit.surface != nullptr ? 1 : 0;
+	}
+
+	const auto light_position = world->lamp->get_location();
+	const auto shadow_ms = best_time([&]()
+	{
+		scheduler.run(threads, [&](const tile& region, unsigned)
+		{
+			for (auto y = region.y; y < region.y + region.height; y++)
+			{
+				for (auto x = region.x; x < region.x + region.width; x++)
+				{
+					const auto& hit = hits[y * width + x];
+					if (hit.surface == nullptr)
+					{
+						continue;
+					}
+					const auto to_light = light_position - hit.position;
+					const auto distance = length(to_light);
+					renderer->occluded(ray(hit.position, to_light / distance), distance - ray_epsilon);
+				}
+			}
+		});
+	});
+	result.shadow_rays_per_second = surface_hits / (shadow_ms / 1000.0);
+
+	const auto secondary_ms = best_time([&]()
+	{
+		scheduler.run(threads, [&](const tile& region, unsigned)
+		{
+			for (auto y = region.y; y < region.y + region.height; y++)
+			{
+				for (auto x = region.x; x < region.x + region.width; x++)
+				{
+					const auto index = y * width + x;
+					const auto& hit = hits[index];
+					if (hit.surface == nullptr)
+					{
+						continue;
+					}
+					auto bounce = intersection();
+					renderer->intersect(ray(hit.position, bounce_direction(rays[index], hit, unsigned(index))), bounce);
+				}
+			}
+		});
+	});
+	result.secondary_rays_per_second = surface_hits / (secondary_ms / 1000.0);
+
+	const auto frame = new image(width, height);
+	result.frame_ms = best_time([&]() { renderer->render(frame, threads); });
+	result.wavefront_frame_ms = best_time([&]() { renderer->render_wavefront(frame, threads); });
+	result.process_peak_memory_bytes = peak_memory();
+
+	delete frame;
+	delete renderer;
+	return result;
+}
+
+// text in quotes with the characters JSON does not allow there escaped; user scenes are named by their path, which may hold
+// backslashes
+inline void write_json_string(std::ostream& out, const std::string& text)
+{
+	out << '"';
+	for (const auto character : text)
+	{
+		switch (character)
+		{
+		case '"':
+			out << "\\\"";
+			break;
+		case '\\':
+			out << "\\\\";
+			break;
+		case '\n':
+			out << "\\n";
+			break;
+		case '\r':
+			out << "\\r";
+			break;
+		case '\t':
+			out << "\\t";
+			break;
+		default:
+			if (static_cast<unsigned char>(character) < 0x20)
+			{
+				char escaped[8];
+				snprintf(escaped, sizeof(escaped), "\\u%04x", unsigned(static_cast<unsigned char>(character)));
+				out << escaped;
+			}
+			else
+			{
+				out << character;
+			}
+			break;
+		}
+	}
+	out << '"';
+}
+
+inline void write_json(std::ostream& out, const std::vector<benchmark_result>& results, const unsigned threads)
+{
+	out << "{\n";
+	out << "  \"simd\": \"" << simd_name(active_kernels().level) << "\",\n";
+	out << "  \"threads\": " << (threads == 0 ? tile_scheduler::default_threads() : threads) << ",\n";
+	out << "  \"runs\": " << benchmark_runs << ",\n";
+	out << "  \"scenes\": [\n";
+	for (auto i = size_t(0); i < results.size(); i++)
+	{
+		const auto& result = results[i];
+		out << "    {\n";
+		out << "      \"name\": ";
+		write_json_string(out, result.name);
+		out << ",\n";
+		out << "      \"triangles\": " << result.triangles << ",\n";
+		out << "      \"instances\": " << result.instances << ",\n";
+		out << "      \"spheres\": " << result.spheres << ",\n";
+		out << "      \"width\": " << result.width << ",\n";
+		out << "      \"height\": " << result.height << ",\n";
+		out << "      \"load_ms\": " << result.load_ms << ",\n";
+		out << "      \"build_ms\": " << result.build_ms << ",\n";
+		out << "      \"refit_ms\": " << result.refit_ms << ",\n";
+		out << "      \"primary_rays_per_second\": " << result.primary_rays_per_second << ",\n";
+		out << "      \"shadow_rays_per_second\": " << result.shadow_rays_per_second << ",\n";
+		out << "      \"secondary_rays_per_second\": " << result.secondary_rays_per_second << ",\n";
+		out << "      \"frame_ms\": " << result.frame_ms << ",\n";
+		out << "      \"wavefront_frame_ms\": " << result.wavefront_frame_ms << ",\n";
+		out << "      \"structure_bytes\": " << result.structure_bytes << ",\n";
+		out << "      \"process_peak_memory_bytes\": " << result.process_peak_memory_bytes << "\n";
+		out << "    }" << (i + 1 < results.size() ? "," : "") << "\n";
+	}
+	out << "  ]\n";
+	out << "}\n";
+}
+
+// runs every fixed scene, then the one in scene_path if there is one, and writes the report to output, or to stdout when output is null
+inline int run_benchmarks(const char* output, const char* scene_path, const int width, const int height, const unsigned threads)
+{
+	auto results = std::vector<benchmark_result>();
+	const auto add = [&](const char* name, scene* (*build)())
+	{
+		const auto world = build();
+		results.push_back(run_benchmark(name, world, width, height, threads));
+		delete world;
+		// one progress line per scene on stderr, the report may be going to stdout
+		fprintf(stderr, "%s done\n", name);
+	};
+	add("cornell_box", cornell_box);
+	add("many_spheres", many_spheres);
+	add("large_mesh", large_mesh);
+	if (scene_path != nullptr)
+	{
+		auto world = static_cast<scene*>(nullptr);
+		const auto load_ms = best_time([&]()
+		{
+			delete world;
+			world = load_scene(scene_path);
+		});
+		if (world == nullptr)
+		{
+			return EXIT_FAILURE;
+		}
+		results.push_back(run_benchmark(scene_path, world, width, height, threads));
+		results.back().load_ms = load_ms;
+		delete world;
+		fprintf(stderr, "%s done\n", scene_path);
+	}
+
+	if (output == nullptr)
+	{
+		write_json(std::cout, results, threads);
+		return EXIT_SUCCESS;
+	}
+	std::ofstream file(output);
+	write_json(file, results, threads);
+	if (!file)
+	{
+		fprintf(stderr, "Error: could not write %s\n", output);
+		return EXIT_FAILURE;
+	}
+	return EXIT_SUCCESS;
+}
+#endif
@@ -0,0 +1,556 @@
+// Bounding volume hierarchy over any list of primitive boxes, built with a binned surface area heuristic. When primitives
+// only move, refit() updates the bounds in place and rebuilds just the subtrees that have grown too loose.
+#ifndef BVH_H
+#define BVH_H
+
+#include <../src/ray.cpp>
+#include <../src/profiler.cpp>
+#include <algorithm>
+#include <vector>
+
+const int bvh_bins = 16;
+const int bvh_max_depth = 60;
+const int bvh_max_leaf = 8;
+const int bvh_stack_size = 64;
+// relative cost of one node visit against one primitive test
+const float bvh_traversal_cost = 1.0f;
+// a refitted node whose surface area has grown by more than this since it was built gets its subtree rebuilt
+const float bvh_refit_limit = 2.0f;
+
+// 32 bytes, two nodes per cache line; children of an interior node are always stored next to each other
+struct bvh_node
+{
+	vec3 minimum;
+	int first;  // left child for interior nodes, first primitive for leaves
+	vec3 maximum;
+	int count;  // 0 for interior nodes, negative for nodes left behind by a partial rebuild
+
+	bool is_leaf() const
+	{
+		return this->count > 0;
+	}
+
+	float intersect(const ray& r, const float closest) const
+	{
+		const auto near_planes = (this->minimum - r.origin) * r.inverse_direction;
+		const auto far_planes = (this->maximum - r.origin) * r.inverse_direction;
+		const auto entry = min(near_planes, far_planes);
+		const auto exit = max(near_planes, far_planes);
+		const auto t_entry = max(max(entry.x, entry.y), max(entry.z, 0.0f));
+		const auto t_exit = min(min(exit.x, exit.y), min(exit.z, closest));
+		return t_entry <= t_exit ? t_entry : FLT_MAX;
+	}
+};
+
+class bvh
+{
+	struct bin
+	{
+		aabb bounds;
+		int count = 0;
+	};
+
+	std::vector<bvh_node> nodes_;
+	std::vector<int> indices_;
+	std::vector<aabb> boxes_;
+	std::vector<vec3> centroids_;
+	// area of every node when it was last built, what refit() measures it against
+	std::vector<float> built_areas_;
+	// nodes no longer reachable after partial rebuilds, reclaimed by a full one
+	int dead_nodes_ = 0;
+	// per node scratch of refit(): the primitive range below it and its depth
+	std::vector<int> range_first_;
+	std::vector<int> range_count_;
+	std::vector<int> depths_;
+
+	void fit(const int node_index)
+	{
+		auto& node = this->nodes_[node_index];
+		auto box = aabb();
+		for (auto i = node.first; i < node.first + node.count; i++)
+		{
+			box.grow(this->boxes_[this->indices_[i]]);
+		}
+		node.minimum = box.minimum;
+		node.maximum = box.maximum;
+	}
+
+	// returns the cheapest split cost, or FLT_MAX when no plane separates the centroids
+	float find_split(const bvh_node& node, int& best_axis, float& best_position) const
+	{
+		auto centroid_bounds = aabb();
+		for (auto i = node.first; i < node.first + node.count; i++)
+		{
+			centroid_bounds.grow(this->centroids_[this->indices_[i]]);
+		}
+
+		auto best_cost = FLT_MAX;
+		for (auto axis = 0; axis < 3; axis++)
+		{
+			const auto lower = centroid_bounds.minimum[axis];
+			const auto upper = centroid_bounds.maximum[axis];
+			if (upper <= lower)
+			{
+				continue;
+			}
+			bin bins[bvh_bins];
+			const auto scale = bvh_bins / (upper - lower);
+			for (auto i = node.first; i < node.first + node.count; i++)
+			{
+				const auto index = this->indices_[i];
+				const auto slot = std::min(bvh_bins - 1, int((this->centroids_[index][axis] - lower) * scale));
+				bins[slot].count++;
+				bins[slot].bounds.grow(this->boxes_[index]);
+			}
+
+			// sweep from both sides so every plane between bins is priced in linear time
+			float left_area[bvh_bins - 1];
+			int left_count[bvh_bins - 1];
+			auto left_box = aabb();
+			auto left_sum = 0;
+			for (auto i = 0; i < bvh_bins - 1; i++)
+			{
+				left_sum += bins[i].count;
+				left_count[i] = left_sum;
+				if (bins[i].count > 0)
+				{
+					left_box.grow(bins[i].bounds);
+				}
+				left_area[i] = left_sum > 0 ? left_box.area() : 0.0f;
+			}
+			auto right_box = aabb();
+			auto right_sum = 0;
+			for (auto i = bvh_bins - 1; i > 0; i--)
+			{
+				right_sum += bins[i].count;
+				if (bins[i].count > 0)
+				{
+					right_box.grow(bins[i].bounds);
+				}
+				if (left_count[i - 1] == 0 || right_sum == 0)
+				{
+					continue;
+				}
+				const auto cost = left_count[i - 1] * left_area[i - 1] + right_sum * right_box.area();
+				if (cost < best_cost)
+				{
+					best_cost = cost;
+					best_axis = axis;
+					best_position = lower + i / scale;
+				}
+			}
+		}
+		return best_cost;
+	}
+
+	void subdivide(const int node_index, const int depth)
+	{
+		const auto node = this->nodes_[node_index];
+		if (node.count <= 2 || depth >= bvh_max_depth)
+		{
+			return;
+		}
+		auto axis = 0;
+		auto position = 0.0f;
+		const auto split_cost = this->find_split(node, axis, position);
+		const auto parent_area = aabb_area(node);
+		if (node.count <= bvh_max_leaf && (split_cost == FLT_MAX || bvh_traversal_cost + split_cost / parent_area >= float(node.count)))
+		{
+			return;
+		}
+
+		auto middle = node.first + node.count / 2;
+		if (split_cost != FLT_MAX)
+		{
+			middle = int(std::partition(this->indices_.begin() + node.first, this->indices_.begin() + node.first + node.count,
+				[&](const int index) { return this->centroids_[index][axis] < position; }) - this->indices_.begin());
+		}
+		// coincident centroids cannot be separated by a plane, oversized leaves are halved in place instead
+		if (middle == node.first || middle == node.first + node.count)
+		{
+			if (node.count <= bvh_max_leaf)
+			{
+				return;
+			}
+			middle = node.first + node.count / 2;
+		}
+		const auto left_count = middle - node.first;
+
+		const auto left = int(this->nodes_.size());
+		this->nodes_.push_back({ vec3(0.0f), node.first, vec3(0.0f), left_count });
+		this->nodes_.push_back({ vec3(0.0f), middle, vec3(0.0f), node.count - left_count });
+		this->nodes_[node_index].first = left;
+		this->nodes_[node_index].count = 0;
+		this->fit(left);
+		this->fit(left + 1);
+		this->subdivide(left, depth + 1);
+		this->subdivide(left + 1, depth + 1);
+	}
+
+	static float aabb_area(const bvh_node& node)
+	{
+		const auto extent = node.maximum - node.minimum;
+		return std::max(extent.x * extent.y + extent.y * extent.z + extent.z * extent.x, 1e-12f);
+	}
+
+	// nodes from first on were just built
+	void record_areas(const int first)
+	{
+		this->built_areas_.resize(this->nodes_.size());
+		for (auto i = first; i < int(this->nodes_.size()); i++)
+		{
+			this->built_areas_[i] = aabb_area(this->nodes_[i]);
+		}
+	}
+
+	// drops the subtree under node_index and builds it again over the same primitive range; its new nodes go to the end
+	// so children still come after their parents
+	void rebuild(const int node_index)
+	{
+		auto pending = std::vector<int>{ node_index };
+		while (!pending.empty())
+		{
+			const auto index = pending.back();
+			pending.pop_back();
+			auto& node = this->nodes_[index];
+			if (node.count == 0)
+			{
+				pending.push_back(node.first);
+				pending.push_back(node.first + 1);
+			}
+			if (index != node_index)
+			{
+				node.count = -1;
+				this->dead_nodes_++;
+			}
+		}
+		auto& root = this->nodes_[node_index];
+		root.first = this->range_first_[node_index];
+		root.count = this->range_count_[node_index];
+		const auto first_new = int(this->nodes_.size());
+		this->fit(node_index);
+		this->subdivide(node_index, this->depths_[node_index]);
+		this->built_areas_[node_index] = aabb_area(this->nodes_[node_index]);
+		this->record_areas(first_new);
+	}
+
+public:
+	// primitives are identified by their position in boxes; get_indices() gives the order leaves refer to
+	void build(const std::vector<aabb>& boxes)
+	{
+		PROFILE_SCOPE("bvh build");
+		this->boxes_ = boxes;
+		this->centroids_.resize(boxes.size());
+		this->indices_.resize(boxes.size());
+		for (auto i = 0; i < int(boxes.size()); i++)
+		{
+			this->centroids_[i] = boxes[i].centre();
+			this->indices_[i] = i;
+		}
+		this->nodes_.clear();
+		this->dead_nodes_ = 0;
+		if (!boxes.empty())
+		{
+			this->nodes_.reserve(boxes.size() * 2);
+			this->nodes_.push_back({ vec3(0.0f), 0, vec3(0.0f), int(boxes.size()) });
+			this->fit(0);
+			this->subdivide(0, 0);
+		}
+		this->record_areas(0);
+
+		// the build inputs are not needed for traversal
+		this->boxes_ = std::vector<aabb>();
+		this->centroids_ = std::vector<vec3>();
+	}
+
+	// boxes are the primitives' new bounds in stored order, i.e. in the order of get_indices() after the last build.
+	// Bounds are updated bottom up; subtrees whose root grew by more than bvh_refit_limit since it was built are rebuilt in
+	// place, and everything is rebuilt once the nodes left behind outnumber the live ones. Afterwards get_indices() maps every
+	// stored position to the position in boxes of the primitive now there; returns false when that is still the identity.
+	bool refit(const std::vector<aabb>& boxes)
+	{
+		PROFILE_SCOPE("bvh refit");
+		if (this->nodes_.empty() || boxes.size() != this->indices_.size())
+		{
+			this->build(boxes);
+			return true;
+		}
+		this->boxes_ = boxes;
+		this->centroids_.resize(boxes.size());
+		for (auto i = 0; i < int(boxes.size()); i++)
+		{
+			this->centroids_[i] = boxes[i].centre();
+			this->indices_[i] = i;
+		}
+
+		// children are always stored after their parent, so one backward pass sees them first
+		const auto count = int(this->nodes_.size());
+		this->range_first_.resize(count);
+		this->range_count_.resize(count);
+		for (auto i = count - 1; i >= 0; i--)
+		{
+			auto& node = this->nodes_[i];
+			if (node.count < 0)
+			{
+				continue;
+			}
+			if (node.is_leaf())
+			{
+				this->fit(i);
+				this->range_first_[i] = node.first;
+				this->range_count_[i] = node.count;
+				continue;
+			}
+			const auto& left = this->nodes_[node.first];
+			const auto& right = this->nodes_[node.first + 1];
+			node.minimum = min(left.minimum, right.minimum);
+			node.maximum = max(left.maximum, right.maximum);
+			this->range_first_[i] = this->range_first_[node.first];
+			this->range_count_[i] = this->range_count_[node.first] + this->range_count_[node.first + 1];
+		}
+
+		// and a forward pass sees parents first, so only the topmost degraded nodes are rebuilt; the nodes under them are dead
+		// by the time the pass gets there, and the new ones lie past count
+		this->depths_.assign(count, 0);
+		auto rebuilt = false;
+		for (auto i = 0; i < count; i++)
+		{
+			const auto node = this->nodes_[i];
+			if (node.count < 0)
+			{
+				continue;
+			}
+			if (aabb_area(node) > bvh_refit_limit * this->built_areas_[i])
+			{
+				this->rebuild(i);
+				rebuilt = true;
+			}
+			else if (!node.is_leaf())
+			{
+				this->depths_[node.first] = this->depths_[node.first + 1] = this->depths_[i] + 1;
+			}
+		}
+		if (this->dead_nodes_ * 2 > int(this->nodes_.size()))
+		{
+			this->build(boxes);
+			return true;
+		}
+		this->boxes_.clear();
+		this->centroids_.clear();
+		return rebuilt;
+	}
+
+	// takes over a hierarchy built earlier, e.g. stored in a scene file, instead of building one
+	void assign(const bvh_node* nodes, const size_t node_count, const int* indices, const size_t index_count)
+	{
+		this->nodes_.assign(nodes, nodes + node_count);
+		this->indices_.assign(indices, indices + index_count);
+		this->dead_nodes_ = 0;
+		this->record_areas(0);
+	}
+
+	const std::vector<int>& get_indices() const
+	{
+		return this->indices_;
+	}
+
+	const std::vector<bvh_node>& get_nodes() const
+	{
+		return this->nodes_;
+	}
+
+	size_t get_memory_usage() const
+	{
+		return this->nodes_.capacity() * sizeof(bvh_node) + this->indices_.capacity() * sizeof(int)
+			+ this->built_areas_.capacity() * sizeof(float);
+	}
+
+	// closest hit traversal; test(first, count, ray, record) intersects one leaf range and shrinks record.distance on a hit
+	template <typename leaf_test>
+	bool intersect(const ray& r, intersection& record, leaf_test test) const
+	{
+		if (this->nodes_.empty())
+		{
+			return false;
+		}
+		if (this->nodes_[0].intersect(r, record.distance) == FLT_MAX)
+		{
+			PROFILE_COUNT(bvh_nodes, 1);
+			return false;
+		}
+		int stack[bvh_stack_size];
+		float entries[bvh_stack_size];
+		auto stack_top = 0;
+		auto node = &this->nodes_[0];
+		auto found = false;
+		auto visited = 1;
+		for (;;)
+		{
+			if (node->is_leaf())
+			{
+				found |= test(node->first, node->count, r, record);
+				node = nullptr;
+			}
+			else
+			{
+				// descend into the nearer child first, the farther one waits on the stack
+				const auto left = &this->nodes_[node->first];
+				const auto right = &this->nodes_[node->first + 1];
+				const auto t_left = left->intersect(r, record.distance);
+				const auto t_right = right->intersect(r, record.distance);
+				visited += 2;
+				if (t_left == FLT_MAX)
+				{
+					node = t_right == FLT_MAX ? nullptr : right;
+				}
+				else if (t_right == FLT_MAX)
+				{
+					node = left;
+				}
+				else if (t_left <= t_right)
+				{
+					stack[stack_top] = node->first + 1;
+					entries[stack_top++] = t_right;
+					node = left;
+				}
+				else
+				{
+					stack[stack_top] = node->first;
+					entries[stack_top++] = t_left;
+					node = right;
+				}
+			}
+			// skip anything on the stack that starts behind the closest hit found since it was pushed
+			while (node == nullptr && stack_top > 0)
+			{
+				stack_top--;
+				if (entries[stack_top] < record.distance)
+				{
+					node = &this->nodes_[stack[stack_top]];
+				}
+			}
+			if (node == nullptr)
+			{
+				PROFILE_COUNT(bvh_nodes, visited);
+				return found;
+			}
+		}
+	}
+
+	// any hit traversal for shadow rays: children are visited in stored order and the first leaf for which test(first, count, ray)
+	// reports a hit closer than max_distance ends the search
+	template <typename leaf_test>
+	bool occluded(const ray& r, const float max_distance, leaf_test test) const
+	{
+		if (this->nodes_.empty())
+		{
+			return false;
+		}
+		int stack[bvh_stack_size];
+		auto stack_top = 0;
+		stack[stack_top++] = 0;
+		auto visited = 0;
+		while (stack_top > 0)
+		{
+			const auto& node = this->nodes_[stack[--stack_top]];
+			visited++;
+			if (node.intersect(r, max_distance) == FLT_MAX)
+			{
+				continue;
+			}
+			if (node.is_leaf())
+			{
+				if (test(node.first, node.count, r))
+				{
+					PROFILE_COUNT(bvh_nodes, visited);
+					return true;
+				}
+				continue;
+			}
+			stack[stack_top++] = node.first + 1;
+			stack[stack_top++] = node.first;
+		}
+		PROFILE_COUNT(bvh_nodes, visited);
+		return false;
+	}
+
+	// packet traversal: a node is entered when any lane of the packet reaches it, children are visited along the packet's mean direction
+	template <typename packet_type, typename node_test, typename leaf_test>
+	void intersect_packet(packet_type& packet, node_test test_node, leaf_test test_leaf) const
+	{
+		if (this->nodes_.empty())
+		{
+			return;
+		}
+		int stack[bvh_stack_size];
+		auto stack_top = 0;
+		stack[stack_top++] = 0;
+		auto visited = 0;
+		while (stack_top > 0)
+		{
+			const auto& node = this->nodes_[stack[--stack_top]];
+			visited++;
+			if (!test_node(packet, node))
+			{
+				continue;
+			}
+			if (node.is_leaf())
+			{
+				test_leaf(node.first, node.count, packet);
+				continue;
+			}
+			const auto& left = this->nodes_[node.first];
+			const auto& right = this->nodes_[node.first + 1];
+			const auto right_first = dot((right.minimum + right.maximum) - (left.minimum + left.maximum), packet.mean_direction) < 0.0f;
+			stack[stack_top++] = right_first ? node.first : node.first + 1;
+			stack[stack_top++] = right_first ? node.first + 1 : node.first;
+		}
+		PROFILE_COUNT(bvh_nodes, visited);
+	}
+};
+
+// puts items in the order the tree's leaves refer to them
+template <typename item>
+void reorder(std::vector<item>& items, const bvh& tree)
+{
+	auto ordered = std::vector<item>();
+	ordered.reserve(items.size());
+	for (const auto index : tree.get_indices())
+	{
+		ordered.push_back(items[index]);
+	}
+	items.swap(ordered);
+}
+
+// builds tree over the primitives' bounds, then reorders them so every leaf reads one contiguous run
+template <typename primitive>
+void build_tree(std::vector<primitive>& primitives, bvh& tree)
+{
+	auto boxes = std::vector<aabb>();
+	boxes.reserve(primitives.size());
+	for (const auto& item : primitives)
+	{
+		boxes.push_back(item.bounds());
+	}
+	tree.build(boxes);
+	reorder(primitives, tree);
+}
+
+// primitives must still be in the order of the tree's leaves; returns true when they had to be reordered
+template <typename primitive>
+bool refit_tree(std::vector<primitive>& primitives, bvh& tree)
+{
+	auto boxes = std::vector<aabb>();
+	boxes.reserve(primitives.size());
+	for (const auto& item : primitives)
+	{
+		boxes.push_back(item.bounds());
+	}
+	if (!tree.refit(boxes))
+	{
+		return false;
+	}
+	reorder(primitives, tree);
+	return true;
+}
+#endif
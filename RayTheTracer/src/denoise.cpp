@@ -0,0 +1,410 @@
+// Edge avoiding a-trous filter (Dammertz et al. 2010): passes of a 5x5 B3 spline kernel whose taps lie 1, 2, 4, 8 and 16
+// pixels apart, every tap weighted down by how far its normal, albedo and depth are from the centre's, and its luminance
+// measured against the centre's noise as in SVGF (Schied et al. 2017). Noisy flat regions are averaged over a wide footprint,
+// an edge in any of the features stops the blur and pixels whose samples agreed are left nearly alone, so a few samples per
+// pixel come close to what hundreds give. The variance is filtered along with the color, so every pass sees the noise the
+// last one left. The threads share every pass tile by tile and rows are filtered 4 or 8 pixels at a time with the
+// instruction set the intersection kernels use.
+#ifndef DENOISE_H
+#define DENOISE_H
+
+#include <../src/image.cpp>
+#include <../src/scheduler.cpp>
+#include <../src/simd.cpp>
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+// how different two pixels may be before the filter stops averaging them; a sigma of 0 leaves the normal, albedo or depth out
+struct denoise_settings
+{
+	int passes;
+	// difference of the luminances in standard deviations of the centre's
+	float color_sigma;
+	// length of the difference of the normals
+	float normal_sigma;
+	float albedo_sigma;
+	// difference of the depths relative to the centre's
+	float depth_sigma;
+
+	denoise_settings() : passes(5), color_sigma(4.0f), normal_sigma(0.2f), albedo_sigma(0.1f), depth_sigma(0.05f) {}
+};
+
+// one pass over planes of width * height floats
+struct filter_pass
+{
+	const float* color[3];
+	const float* variance;
+	float* filtered[3];
+	float* filtered_variance;
+	const float* normal[3];
+	const float* albedo[3];
+	const float* depth;
+	int width;
+	int height;
+	// pixels between neighbouring taps
+	int step;
+	// sigma^2 of the color, the centre's variance scales it
+	float color_spread;
+	// 1 / sigma^2 of each feature; the depth's is divided by the centre's squared depth as well
+	float normal_weight;
+	float albedo_weight;
+	float depth_weight;
+};
+
+// B3 spline
+const float atrous_kernel[5] = { 1.0f / 16.0f, 1.0f / 4.0f, 3.0f / 8.0f, 1.0f / 4.0f, 1.0f / 16.0f };
+// keeps the depth weight of pixels that hit nothing finite; they only blend with each other
+const float least_depth_squared = 1e-8f;
+// luminance differences of about its square root are tolerated where the samples all agreed
+const float least_luminance_spread = 1e-4f;
+const float luminance_red = 0.2126f;
+const float luminance_green = 0.7152f;
+const float luminance_blue = 0.0722f;
+
+// ---------------------------------------------------------------- scalar
+
+// e^-x for x >= 0 as 2^-i * 2^-f with t = x / ln 2 = i + f: the exponent bits give 2^-i and a polynomial 2^-f, within 2e-4
+// of the real thing. The vector versions take the same steps, so every level filters alike
+inline float exp_negative(const float x)
+{
+	const auto t = std::min(x * 1.44269504f, 100.0f);
+	const auto whole = int(t);
+	const auto f = t - float(whole);
+	const auto fraction = 1.0f + f * (-0.693147f + f * (0.240227f + f * (-0.0555041f + f * (0.00961813f + f * -0.00133336f))));
+	const auto bits = uint32_t(127 - whole) << 23;
+	float scale;
+	memcpy(&scale, &bits, sizeof(scale));
+	return fraction * scale;
+}
+
+inline void filter_pixel(const filter_pass& pass, const int x, const int y)
+{
+	const auto centre = y * pass.width + x;
+	const auto luminance = vec3(luminance_red, luminance_green, luminance_blue);
+	const auto brightness = dot(vec3(pass.color[0][centre], pass.color[1][centre], pass.color[2][centre]), luminance);
+	const auto color_weight = 1.0f / (pass.color_spread * pass.variance[centre] + least_luminance_spread);
+	const auto normal = vec3(pass.normal[0][centre], pass.normal[1][centre], pass.normal[2][centre]);
+	const auto albedo = vec3(pass.albedo[0][centre], pass.albedo[1][centre], pass.albedo[2][centre]);
+	const auto depth = pass.depth[centre];
+	const auto depth_weight = pass.depth_weight / std::max(depth * depth, least_depth_squared);
+	auto sum = vec3(0.0f);
+	auto sum_variance = 0.0f;
+	auto total = 0.0f;
+	for (auto row = 0; row < 5; row++)
+	{
+		const auto tap_y = y + (row - 2) * pass.step;
+		if (tap_y < 0 || tap_y >= pass.height)
+		{
+			continue;
+		}
+		for (auto column = 0; column < 5; column++)
+		{
+			const auto tap_x = x + (column - 2) * pass.step;
+			if (tap_x < 0 || tap_x >= pass.width)
+			{
+				continue;
+			}
+			const auto tap = tap_y * pass.width + tap_x;
+			const auto tap_color = vec3(pass.color[0][tap], pass.color[1][tap], pass.color[2][tap]);
+			const auto brightness_difference = dot(tap_color, luminance) - brightness;
+			const auto normal_difference = vec3(pass.normal[0][tap], pass.normal[1][tap], pass.normal[2][tap]) - normal;
+			const auto albedo_difference = vec3(pass.albedo[0][tap], pass.albedo[1][tap], pass.albedo[2][tap]) - albedo;
+			const auto depth_difference = pass.depth[tap] - depth;
+			const auto distance = color_weight * brightness_difference * brightness_difference
+				+ pass.normal_weight * dot(normal_difference, normal_difference)
+				+ pass.albedo_weight * dot(albedo_difference, albedo_difference)
+				+ depth_weight * depth_difference * depth_difference;
+			const auto weight = atrous_kernel[row] * atrous_kernel[column] * exp_negative(distance);
+			sum += weight * tap_color;
+			sum_variance += weight * weight * pass.variance[tap];
+			total += weight;
+		}
+	}
+	// the centre tap always has a weight, so total is never 0
+	sum /= total;
+	pass.filtered[0][centre] = sum.r;
+	pass.filtered[1][centre] = sum.g;
+	pass.filtered[2][centre] = sum.b;
+	pass.filtered_variance[centre] = sum_variance / (total * total);
+}
+
+inline void scalar_filter_span(const filter_pass& pass, const int y, const int first, const int last)
+{
+	for (auto x = first; x < last; x++)
+	{
+		filter_pixel(pass, x, y);
+	}
+}
+
+// ---------------------------------------------------------------- sse
+
+inline __m128 sse_exp_negative(const __m128 x)
+{
+	const auto t = _mm_min_ps(_mm_mul_ps(x, _mm_set1_ps(1.44269504f)), _mm_set1_ps(100.0f));
+	const auto whole = _mm_cvttps_epi32(t);
+	const auto f = _mm_sub_ps(t, _mm_cvtepi32_ps(whole));
+	auto fraction = _mm_add_ps(_mm_set1_ps(0.00961813f), _mm_mul_ps(f, _mm_set1_ps(-0.00133336f)));
+	fraction = _mm_add_ps(_mm_set1_ps(-0.0555041f), _mm_mul_ps(f, fraction));
+	fraction = _mm_add_ps(_mm_set1_ps(0.240227f), _mm_mul_ps(f, fraction));
+	fraction = _mm_add_ps(_mm_set1_ps(-0.693147f), _mm_mul_ps(f, fraction));
+	fraction = _mm_add_ps(_mm_set1_ps(1.0f), _mm_mul_ps(f, fraction));
+	const auto scale = _mm_castsi128_ps(_mm_slli_epi32(_mm_sub_epi32(_mm_set1_epi32(127), whole), 23));
+	return _mm_mul_ps(fraction, scale);
+}
+
+inline __m128 sse_square_distance(const float* const* planes, const int offset, const __m128* centre)
+{
+	const auto x = _mm_sub_ps(_mm_loadu_ps(planes[0] + offset), centre[0]);
+	const auto y = _mm_sub_ps(_mm_loadu_ps(planes[1] + offset), centre[1]);
+	const auto z = _mm_sub_ps(_mm_loadu_ps(planes[2] + offset), centre[2]);
+	return _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, x), _mm_mul_ps(y, y)), _mm_mul_ps(z, z));
+}
+
+// pixels whose taps all lie inside the row go 4 at a time, the ones near its ends one by one
+inline void sse_filter_span(const filter_pass& pass, const int y, const int first, const int last)
+{
+	const auto reach = 2 * pass.step;
+	const auto red = _mm_set1_ps(luminance_red);
+	const auto green = _mm_set1_ps(luminance_green);
+	const auto blue = _mm_set1_ps(luminance_blue);
+	const auto normal_weight = _mm_set1_ps(pass.normal_weight);
+	const auto albedo_weight = _mm_set1_ps(pass.albedo_weight);
+	auto x = first;
+	while (x < last)
+	{
+		if (x < reach || x + 4 > last || x + 4 + reach > pass.width)
+		{
+			filter_pixel(pass, x, y);
+			x++;
+			continue;
+		}
+		const auto centre = y * pass.width + x;
+		const auto brightness = _mm_add_ps(_mm_add_ps(_mm_mul_ps(red, _mm_loadu_ps(pass.color[0] + centre)), _mm_mul_ps(green, _mm_loadu_ps(pass.color[1] + centre))),
+			_mm_mul_ps(blue, _mm_loadu_ps(pass.color[2] + centre)));
+		const auto color_weight = _mm_div_ps(_mm_set1_ps(1.0f), _mm_add_ps(_mm_mul_ps(_mm_set1_ps(pass.color_spread), _mm_loadu_ps(pass.variance + centre)), _mm_set1_ps(least_luminance_spread)));
+		const __m128 normal[3] = { _mm_loadu_ps(pass.normal[0] + centre), _mm_loadu_ps(pass.normal[1] + centre), _mm_loadu_ps(pass.normal[2] + centre) };
+		const __m128 albedo[3] = { _mm_loadu_ps(pass.albedo[0] + centre), _mm_loadu_ps(pass.albedo[1] + centre), _mm_loadu_ps(pass.albedo[2] + centre) };
+		const auto depth = _mm_loadu_ps(pass.depth + centre);
+		const auto depth_weight = _mm_div_ps(_mm_set1_ps(pass.depth_weight), _mm_max_ps(_mm_mul_ps(depth, depth), _mm_set1_ps(least_depth_squared)));
+		auto sum_r = _mm_setzero_ps();
+		auto sum_g = _mm_setzero_ps();
+		auto sum_b = _mm_setzero_ps();
+		auto sum_variance = _mm_setzero_ps();
+		auto total = _mm_setzero_ps();
+		for (auto row = 0; row < 5; row++)
+		{
+			const auto tap_y = y + (row - 2) * pass.step;
+			if (tap_y < 0 || tap_y >= pass.height)
+			{
+				continue;
+			}
+			for (auto column = 0; column < 5; column++)
+			{
+				const auto tap = tap_y * pass.width + x + (column - 2) * pass.step;
+				const auto tap_r = _mm_loadu_ps(pass.color[0] + tap);
+				const auto tap_g = _mm_loadu_ps(pass.color[1] + tap);
+				const auto tap_b = _mm_loadu_ps(pass.color[2] + tap);
+				const auto brightness_difference = _mm_sub_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(red, tap_r), _mm_mul_ps(green, tap_g)), _mm_mul_ps(blue, tap_b)), brightness);
+				const auto depth_difference = _mm_sub_ps(_mm_loadu_ps(pass.depth + tap), depth);
+				auto distance = _mm_mul_ps(color_weight, _mm_mul_ps(brightness_difference, brightness_difference));
+				distance = _mm_add_ps(distance, _mm_mul_ps(normal_weight, sse_square_distance(pass.normal, tap, normal)));
+				distance = _mm_add_ps(distance, _mm_mul_ps(albedo_weight, sse_square_distance(pass.albedo, tap, albedo)));
+				distance = _mm_add_ps(distance, _mm_mul_ps(depth_weight, _mm_mul_ps(depth_difference, depth_difference)));
+				const auto weight = _mm_mul_ps(_mm_set1_ps(atrous_kernel[row] * atrous_kernel[column]), sse_exp_negative(distance));
+				sum_r = _mm_add_ps(sum_r, _mm_mul_ps(weight, tap_r));
+				sum_g = _mm_add_ps(sum_g, _mm_mul_ps(weight, tap_g));
+				sum_b = _mm_add_ps(sum_b, _mm_mul_ps(weight, tap_b));
+				sum_variance = _mm_add_ps(sum_variance, _mm_mul_ps(_mm_mul_ps(weight, weight), _mm_loadu_ps(pass.variance + tap)));
+				total = _mm_add_ps(total, weight);
+			}
+		}
+		_mm_storeu_ps(pass.filtered[0] + centre, _mm_div_ps(sum_r, total));
+		_mm_storeu_ps(pass.filtered[1] + centre, _mm_div_ps(sum_g, total));
+		_mm_storeu_ps(pass.filtered[2] + centre, _mm_div_ps(sum_b, total));
+		_mm_storeu_ps(pass.filtered_variance + centre, _mm_div_ps(sum_variance, _mm_mul_ps(total, total)));
+		x += 4;
+	}
+}
+
+// ---------------------------------------------------------------- avx2
+
+SIMD_AVX2 inline __m256 avx2_exp_negative(const __m256 x)
+{
+	const auto t = _mm256_min_ps(_mm256_mul_ps(x, _mm256_set1_ps(1.44269504f)), _mm256_set1_ps(100.0f));
+	const auto whole = _mm256_cvttps_epi32(t);
+	const auto f = _mm256_sub_ps(t, _mm256_cvtepi32_ps(whole));
+	auto fraction = _mm256_add_ps(_mm256_set1_ps(0.00961813f), _mm256_mul_ps(f, _mm256_set1_ps(-0.00133336f)));
+	fraction = _mm256_add_ps(_mm256_set1_ps(-0.0555041f), _mm256_mul_ps(f, fraction));
+	fraction = _mm256_add_ps(_mm256_set1_ps(0.240227f), _mm256_mul_ps(f, fraction));
+	fraction = _mm256_add_ps(_mm256_set1_ps(-0.693147f), _mm256_mul_ps(f, fraction));
+	fraction = _mm256_add_ps(_mm256_set1_ps(1.0f), _mm256_mul_ps(f, fraction));
+	const auto scale = _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_sub_epi32(_mm256_set1_epi32(127), whole), 23));
+	return _mm256_mul_ps(fraction, scale);
+}
+
+SIMD_AVX2 inline __m256 avx2_square_distance(const float* const* planes, const int offset, const __m256* centre)
+{
+	const auto x = _mm256_sub_ps(_mm256_loadu_ps(planes[0] + offset), centre[0]);
+	const auto y = _mm256_sub_ps(_mm256_loadu_ps(planes[1] + offset), centre[1]);
+	const auto z = _mm256_sub_ps(_mm256_loadu_ps(planes[2] + offset), centre[2]);
+	return _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(x, x), _mm256_mul_ps(y, y)), _mm256_mul_ps(z, z));
+}
+
+SIMD_AVX2 inline void avx2_filter_span(const filter_pass& pass, const int y, const int first, const int last)
+{
+	const auto reach = 2 * pass.step;
+	const auto red = _mm256_set1_ps(luminance_red);
+	const auto green = _mm256_set1_ps(luminance_green);
+	const auto blue = _mm256_set1_ps(luminance_blue);
+	const auto normal_weight = _mm256_set1_ps(pass.normal_weight);
+	const auto albedo_weight = _mm256_set1_ps(pass.albedo_weight);
+	auto x = first;
+	while (x < last)
+	{
+		if (x < reach || x + 8 > last || x + 8 + reach > pass.width)
+		{
+			filter_pixel(pass, x, y);
+			x++;
+			continue;
+		}
+		const auto centre = y * pass.width + x;
+		const auto brightness = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(red, _mm256_loadu_ps(pass.color[0] + centre)), _mm256_mul_ps(green, _mm256_loadu_ps(pass.color[1] + centre))),
+			_mm256_mul_ps(blue, _mm256_loadu_ps(pass.color[2] + centre)));
+		const auto color_weight = _mm256_div_ps(_mm256_set1_ps(1.0f), _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(pass.color_spread), _mm256_loadu_ps(pass.variance + centre)), _mm256_set1_ps(least_luminance_spread)));
+		const __m256 normal[3] = { _mm256_loadu_ps(pass.normal[0] + centre), _mm256_loadu_ps(pass.normal[1] + centre), _mm256_loadu_ps(pass.normal[2] + centre) };
+		const __m256 albedo[3] = { _mm256_loadu_ps(pass.albedo[0] + centre), _mm256_loadu_ps(pass.albedo[1] + centre), _mm256_loadu_ps(pass.albedo[2] + centre) };
+		const auto depth = _mm256_loadu_ps(pass.depth + centre);
+		const auto depth_weight = _mm256_div_ps(_mm256_set1_ps(pass.depth_weight), _mm256_max_ps(_mm256_mul_ps(depth, depth), _mm256_set1_ps(least_depth_squared)));
+		auto sum_r = _mm256_setzero_ps();
+		auto sum_g = _mm256_setzero_ps();
+		auto sum_b = _mm256_setzero_ps();
+		auto sum_variance = _mm256_setzero_ps();
+		auto total = _mm256_setzero_ps();
+		for (auto row = 0; row < 5; row++)
+		{
+			const auto tap_y = y + (row - 2) * pass.step;
+			if (tap_y < 0 || tap_y >= pass.height)
+			{
+				continue;
+			}
+			for (auto column = 0; column < 5; column++)
+			{
+				const auto tap = tap_y * pass.width + x + (column - 2) * pass.step;
+				const auto tap_r = _mm256_loadu_ps(pass.color[0] + tap);
+				const auto tap_g = _mm256_loadu_ps(pass.color[1] + tap);
+				const auto tap_b = _mm256_loadu_ps(pass.color[2] + tap);
+				const auto brightness_difference = _mm256_sub_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(red, tap_r), _mm256_mul_ps(green, tap_g)), _mm256_mul_ps(blue, tap_b)), brightness);
+				const auto depth_difference = _mm256_sub_ps(_mm256_loadu_ps(pass.depth + tap), depth);
+				auto distance = _mm256_mul_ps(color_weight, _mm256_mul_ps(brightness_difference, brightness_difference));
+				distance = _mm256_add_ps(distance, _mm256_mul_ps(normal_weight, avx2_square_distance(pass.normal, tap, normal)));
+				distance = _mm256_add_ps(distance, _mm256_mul_ps(albedo_weight, avx2_square_distance(pass.albedo, tap, albedo)));
+				distance = _mm256_add_ps(distance, _mm256_mul_ps(depth_weight, _mm256_mul_ps(depth_difference, depth_difference)));
+				const auto weight = _mm256_mul_ps(_mm256_set1_ps(atrous_kernel[row] * atrous_kernel[column]), avx2_exp_negative(distance));
+				sum_r = _mm256_add_ps(sum_r, _mm256_mul_ps(weight, tap_r));
+				sum_g = _mm256_add_ps(sum_g, _mm256_mul_ps(weight, tap_g));
+				sum_b = _mm256_add_ps(sum_b, _mm256_mul_ps(weight, tap_b));
+				sum_variance = _mm256_add_ps(sum_variance, _mm256_mul_ps(_mm256_mul_ps(weight, weight), _mm256_loadu_ps(pass.variance + tap)));
+				total = _mm256_add_ps(total, weight);
+			}
+		}
+		_mm256_storeu_ps(pass.filtered[0] + centre, _mm256_div_ps(sum_r, total));
+		_mm256_storeu_ps(pass.filtered[1] + centre, _mm256_div_ps(sum_g, total));
+		_mm256_storeu_ps(pass.filtered[2] + centre, _mm256_div_ps(sum_b, total));
+		_mm256_storeu_ps(pass.filtered_variance + centre, _mm256_div_ps(sum_variance, _mm256_mul_ps(total, total)));
+		x += 8;
+	}
+}
+
+// ---------------------------------------------------------------- filter
+
+// keeps its planes between frames, so denoising the same size again does not allocate
+class denoiser
+{
+	// two sets of color and variance planes that the passes read from and write to in turn, then the normal, albedo and
+	// depth planes
+	std::vector<float> planes_;
+
+public:
+	// filters target in place, guided by features with one entry per pixel
+	void run(image* target, const pixel_features* features, const denoise_settings& settings = denoise_settings(), const unsigned threads = 0)
+	{
+		PROFILE_SCOPE("denoise");
+		const auto width = target->get_width();
+		const auto height = target->get_height();
+		const auto pixels = size_t(width) * height;
+		this->planes_.resize(pixels * 15);
+		float* plane[15];
+		for (auto i = 0; i < 15; i++)
+		{
+			plane[i] = this->planes_.data() + pixels * i;
+		}
+		const auto colors = target->get_pixels();
+		for (auto i = size_t(0); i < pixels; i++)
+		{
+			for (auto channel = 0; channel < 3; channel++)
+			{
+				plane[channel][i] = colors[i][channel];
+				plane[8 + channel][i] = features[i].normal[channel];
+				plane[11 + channel][i] = features[i].albedo[channel];
+			}
+			plane[3][i] = features[i].variance;
+			plane[14][i] = features[i].depth;
+		}
+
+		const auto weight = [](const float sigma)
+		{
+			return sigma > 0.0f ? 1.0f / (sigma * sigma) : 0.0f;
+		};
+		auto pass = filter_pass();
+		for (auto channel = 0; channel < 3; channel++)
+		{
+			pass.normal[channel] = plane[8 + channel];
+			pass.albedo[channel] = plane[11 + channel];
+		}
+		pass.depth = plane[14];
+		pass.width = width;
+		pass.height = height;
+		pass.color_spread = settings.color_sigma * settings.color_sigma;
+		pass.normal_weight = weight(settings.normal_sigma);
+		pass.albedo_weight = weight(settings.albedo_sigma);
+		pass.depth_weight = weight(settings.depth_sigma);
+		const auto level = active_kernels().level;
+		const auto filter_span = level == simd_level::avx2 ? avx2_filter_span : level == simd_level::sse ? sse_filter_span : scalar_filter_span;
+
+		auto scheduler = tile_scheduler(width, height);
+		auto source = 0;
+		for (auto i = 0; i < settings.passes; i++)
+		{
+			PROFILE_SCOPE("denoise pass");
+			const auto destination = 4 - source;
+			for (auto channel = 0; channel < 3; channel++)
+			{
+				pass.color[channel] = plane[source + channel];
+				pass.filtered[channel] = plane[destination + channel];
+			}
+			pass.variance = plane[source + 3];
+			pass.filtered_variance = plane[destination + 3];
+			pass.step = 1 << i;
+			scheduler.run(threads, [&pass, filter_span](const tile& region, unsigned)
+			{
+				for (auto y = region.y; y < region.y + region.height; y++)
+				{
+					filter_span(pass, y, region.x, region.x + region.width);
+				}
+			});
+			source = destination;
+		}
+
+		for (auto y = 0; y < height; y++)
+		{
+			for (auto x = 0; x < width; x++)
+			{
+				const auto i = size_t(y) * width + x;
+				target->set_pixel(x, y, vec3(plane[source][i], plane[source + 1][i], plane[source + 2][i]));
+			}
+		}
+	}
+};
+#endif
@@ -0,0 +1,584 @@
+// Rendering one frame on several machines. The coordinator packs the scene in its binary form once, sends it to all the
+// workers that connected at the same time and then hands out tiles on demand. Each worker says how many threads it has, and
+// holds two batches of tiles sized to keep them all busy, so none waits on the network between batches. Pixels stream back
+// as batches finish. A worker that drops its connection has its tiles given to the others, and once every tile is out, a
+// tile that has been away much longer than tiles usually take is handed to an idle worker as well; whichever copy comes back
+// first is used. The coordinator never waits on one worker: results are read as far as they have arrived, sends give up on a
+// worker that stops reading, and a worker that leaves a result half sent or goes quiet for far longer than tiles take is
+// dropped like one that disconnected.
+//
+// Messages are a remote_header followed by size bytes, in the byte order of the machine that sent them, so like binary scenes
+// the workers must share the coordinator's.
+#ifndef DISTRIBUTED_H
+#define DISTRIBUTED_H
+
+#include <../src/socket.cpp>
+#include <../src/scene_file.cpp>
+#include <../src/tracer.cpp>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <thread>
+#include <vector>
+
+// edge of the tiles the coordinator hands out, a multiple of the tile_size the workers split them into
+const int remote_tile_size = 64;
+// batches a worker holds at once: one it renders and one waiting behind it
+const size_t remote_batches_in_flight = 2;
+// the most threads a worker is taken at its word for, so a bad hello cannot have it hold the whole frame
+const uint32_t remote_max_threads = 1024;
+// a tile out this many times longer than the average gets a second worker
+const double straggler_factor = 4.0;
+// milliseconds the coordinator waits for the workers to connect; it goes ahead with those that have by then
+const int remote_accept_timeout = 60000;
+// milliseconds a send to a worker may make no progress
+const int remote_send_timeout = 10000;
+// seconds a worker may leave a result half sent
+const double remote_receive_timeout = 10.0;
+// seconds a worker holding tiles may stay quiet, or this many times longer than the average tile takes when that is more;
+// until its first result, the time to load the scene counts too, so it gets remote_startup_timeout instead
+const double remote_silence_timeout = 30.0;
+const double remote_silence_factor = 16.0;
+const double remote_startup_timeout = 600.0;
+// changes whenever a message's layout does, so mismatched builds refuse each other instead of misreading
+const uint32_t remote_protocol = 3;
+
+enum class remote_message : uint32_t
+{
+	// coordinator to worker: a remote_job and the packed scene
+	job = 1,
+	// coordinator to worker: a remote_tile
+	tile = 2,
+	// worker to coordinator: a remote_tile and its pixels, row by row
+	result = 3,
+	// coordinator to worker: the frame is done, disconnect
+	done = 4,
+	// worker to coordinator, right after connecting: a remote_hello
+	hello = 5
+};
+
+struct remote_header
+{
+	remote_message type;
+	uint32_t protocol;
+	// a packed scene can be well over 4 GiB
+	uint64_t size;
+};
+
+struct remote_job
+{
+	int32_t width;
+	int32_t height;
+	int32_t samples;
+	int32_t max_depth;
+	float min_contribution;
+	int32_t roulette_depth;
+	float roulette_weight;
+};
+
+struct remote_hello
+{
+	uint32_t threads;
+};
+
+struct remote_tile
+{
+	int32_t index;
+	int32_t x;
+	int32_t y;
+	int32_t width;
+	int32_t height;
+};
+
+// the packed scene is read in place, so it has to sit at a 16 byte boundary like a mapped file does
+struct alignas(16) scene_chunk
+{
+	unsigned char bytes[16];
+};
+
+// tiles a worker renders together: enough for each of its threads to have one of the tile_size parts they are split into
+inline size_t remote_batch_size(const unsigned threads)
+{
+	const auto parts = unsigned((remote_tile_size / tile_size) * (remote_tile_size / tile_size));
+	return size_t((threads + parts - 1) / parts);
+}
+
+inline bool send_message(connection& link, const remote_message type, const void* payload, const size_t size, const void* extra = nullptr, const size_t extra_size = 0)
+{
+	const auto header = remote_header{ type, remote_protocol, uint64_t(size) + extra_size };
+	return link.send(&header, sizeof(header)) && link.send(payload, size) && (extra_size == 0 || link.send(extra, extra_size));
+}
+
+// renders target with the tracers of worker_count workers that connect to port; false when the port cannot be opened or
+// every worker is lost before the frame is done
+inline bool render_distributed(const scene* world, image* target, const int port, const int worker_count, const int samples, const trace_limits& limits)
+{
+	using clock = std::chrono::steady_clock;
+	struct remote_worker
+	{
+		connection link;
+		// tiles sent and not returned, oldest first
+		std::vector<int> tiles;
+		// what has arrived of results not yet complete
+		std::vector<unsigned char> inbox;
+		// when the oldest byte in inbox arrived
+		clock::time_point partial_since;
+		// when anything last arrived, or the scene finished going out
+		clock::time_point heard;
+		// tiles it may hold, 0 until it has said how many threads it has
+		size_t capacity;
+		bool returned_any;
+	};
+	struct tile_state
+	{
+		remote_tile region;
+		// workers it is out with
+		int copies;
+		bool done;
+		clock::time_point issued;
+	};
+
+	listener server;
+	if (!server.open(port))
+	{
+		fprintf(stderr, "Error: could not listen on port %d\n", port);
+		return false;
+	}
+	const auto packed = pack_scene(world);
+	const auto job = remote_job{ target->get_width(), target->get_height(), samples, limits.max_depth, limits.min_contribution, limits.roulette_depth, limits.roulette_weight };
+	auto workers = std::vector<std::unique_ptr<remote_worker>>();
+	fprintf(stderr, "waiting for %d workers on port %d\n", worker_count, port);
+	const auto deadline = clock::now() + std::chrono::milliseconds(remote_accept_timeout);
+	while (int(workers.size()) < worker_count)
+	{
+		const auto left = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - clock::now()).count();
+		std::unique_ptr<remote_worker> joined(new remote_worker());
+		if (left <= 0 || !server.accept(joined->link, int(left)))
+		{
+			break;
+		}
+		joined->link.set_send_timeout(remote_send_timeout);
+		joined->capacity = 0;
+		joined->returned_any = false;
+		workers.push_back(std::move(joined));
+	}
+	server.close();
+	if (workers.empty())
+	{
+		fprintf(stderr, "Error: no worker connected within %d seconds\n", remote_accept_timeout / 1000);
+		return false;
+	}
+	if (int(workers.size()) < worker_count)
+	{
+		fprintf(stderr, "going ahead with %zu of %d workers\n", workers.size(), worker_count);
+	}
+	// the scene goes to every worker at once, so the slowest link sets the pace instead of the sum of them all
+	{
+		PROFILE_SCOPE("send scene");
+		auto senders = std::vector<std::thread>();
+		for (auto& worker : workers)
+		{
+			const auto joined = worker.get();
+			senders.emplace_back([joined, &job, &packed]()
+			{
+				if (!send_message(joined->link, remote_message::job, &job, sizeof(job), packed.data(), packed.size()))
+				{
+					fprintf(stderr, "could not send the scene to a worker\n");
+					joined->link.close();
+				}
+				joined->heard = clock::now();
+			});
+		}
+		for (auto& sender : senders)
+		{
+			sender.join();
+		}
+	}
+
+	auto tiles = std::vector<tile_state>();
+	for (auto y = 0; y < target->get_height(); y += remote_tile_size)
+	{
+		for (auto x = 0; x < target->get_width(); x += remote_tile_size)
+		{
+			const auto region = remote_tile{ int32_t(tiles.size()), x, y, std::min(remote_tile_size, target->get_width() - x), std::min(remote_tile_size, target->get_height() - y) };
+			tiles.push_back(tile_state{ region, 0, false, clock::time_point() });
+		}
+	}
+	// not yet sent, or back from a lost worker; taken from the back
+	auto pending = std::vector<int>();
+	for (auto i = int(tiles.size()) - 1; i >= 0; i--)
+	{
+		pending.push_back(i);
+	}
+	auto completed = size_t(0);
+	auto round_trips = clock::duration::zero();
+
+	const auto drop = [&](remote_worker& worker)
+	{
+		worker.link.close();
+		for (const auto index : worker.tiles)
+		{
+			auto& state = tiles[index];
+			state.copies--;
+			if (!state.done && state.copies == 0)
+			{
+				pending.push_back(index);
+			}
+		}
+		worker.tiles.clear();
+		fprintf(stderr, "lost a worker, its tiles go to the others\n");
+	};
+
+	// the next tile for worker, or -1 when it should wait
+	const auto next_tile = [&](const remote_worker& worker)
+	{
+		while (!pending.empty())
+		{
+			const auto index = pending.back();
+			pending.pop_back();
+			if (!tiles[index].done)
+			{
+				return index;
+			}
+		}
+		if (completed == 0)
+		{
+			return -1;
+		}
+		const auto now = clock::now();
+		const auto patience = std::chrono::duration_cast<clock::duration>(round_trips * (straggler_factor / double(completed)));
+		auto oldest = -1;
+		for (const auto& state : tiles)
+		{
+			if (state.done || state.copies != 1 || now - state.issued < patience
+				|| std::find(worker.tiles.begin(), worker.tiles.end(), state.region.index) != worker.tiles.end())
+			{
+				continue;
+			}
+			if (oldest < 0 || state.issued < tiles[oldest].issued)
+			{
+				oldest = state.region.index;
+			}
+		}
+		return oldest;
+	};
+
+	// copies a complete result, the remote_tile and its pixels, into target; false when it is not one of worker's tiles or
+	// has the wrong size
+	auto pixels = std::vector<vec3>(size_t(remote_tile_size) * remote_tile_size);
+	const auto store = [&](remote_worker& worker, const unsigned char* message, const size_t size)
+	{
+		auto returned = remote_tile();
+		memcpy(&returned, message, sizeof(returned));
+		const auto owned = std::find(worker.tiles.begin(), worker.tiles.end(), returned.index);
+		if (owned == worker.tiles.end())
+		{
+			return false;
+		}
+		auto& state = tiles[returned.index];
+		const auto count = size_t(state.region.width) * state.region.height;
+		if (size != sizeof(returned) + count * sizeof(vec3))
+		{
+			return false;
+		}
+		worker.tiles.erase(owned);
+		worker.returned_any = true;
+		state.copies--;
+		if (state.done)
+		{
+			return true;
+		}
+		memcpy(pixels.data(), message + sizeof(returned), count * sizeof(vec3));
+		for (auto y = 0; y < state.region.height; y++)
+		{
+			for (auto x = 0; x < state.region.width; x++)
+			{
+				target->set_pixel(state.region.x + x, state.region.y + y, pixels[y * state.region.width + x]);
+			}
+		}
+		state.done = true;
+		completed++;
+		round_trips += clock::now() - state.issued;
+		return true;
+	};
+
+	// sets how many tiles worker may hold from the threads it says it has; false when it already said
+	const auto greet = [&](remote_worker& worker, const unsigned char* message)
+	{
+		auto hello = remote_hello();
+		memcpy(&hello, message, sizeof(hello));
+		if (worker.capacity != 0)
+		{
+			return false;
+		}
+		worker.capacity = remote_batches_in_flight * remote_batch_size(std::max(1u, std::min(unsigned(hello.threads), unsigned(remote_max_threads))));
+		return true;
+	};
+
+	// takes what worker has sent so far without waiting for more, handles every message that is complete and keeps the rest;
+	// false when the worker is gone or talks nonsense
+	const auto largest_result = sizeof(remote_tile) + size_t(remote_tile_size) * remote_tile_size * sizeof(vec3);
+	auto chunk = std::vector<unsigned char>(size_t(1) << 16);
+	const auto receive = [&](remote_worker& worker)
+	{
+		auto received = size_t(0);
+		if (!worker.link.receive_available(chunk.data(), chunk.size(), received))
+		{
+			return false;
+		}
+		worker.heard = clock::now();
+		if (worker.inbox.empty())
+		{
+			worker.partial_since = worker.heard;
+		}
+		worker.inbox.insert(worker.inbox.end(), chunk.begin(), chunk.begin() + received);
+		auto used = size_t(0);
+		while (worker.inbox.size() - used >= sizeof(remote_header))
+		{
+			auto header = remote_header();
+			memcpy(&header, worker.inbox.data() + used, sizeof(header));
+			const auto is_hello = header.type == remote_message::hello && header.size == sizeof(remote_hello);
+			const auto is_result = header.type == remote_message::result && header.size >= sizeof(remote_tile) && header.size <= largest_result;
+			if (header.protocol != remote_protocol || (!is_hello && !is_result))
+			{
+				return false;
+			}
+			const auto size = size_t(header.size);
+			if (worker.inbox.size() - used < sizeof(header) + size)
+			{
+				break;
+			}
+			const auto message = worker.inbox.data() + used + sizeof(header);
+			if (is_hello ? !greet(worker, message) : !store(worker, message, size))
+			{
+				return false;
+			}
+			used += sizeof(header) + size;
+		}
+		worker.inbox.erase(worker.inbox.begin(), worker.inbox.begin() + used);
+		// the unfinished result started in this read
+		if (used > 0 && !worker.inbox.empty())
+		{
+			worker.partial_since = clock::now();
+		}
+		return true;
+	};
+
+	auto polls = std::vector<socket_poll>();
+	auto polled = std::vector<remote_worker*>();
+	while (completed < tiles.size())
+	{
+		polls.clear();
+		polled.clear();
+		for (auto& worker : workers)
+		{
+			while (worker->link.is_open() && worker->tiles.size() < worker->capacity)
+			{
+				const auto index = next_tile(*worker);
+				if (index < 0)
+				{
+					break;
+				}
+				auto& state = tiles[index];
+				if (!send_message(worker->link, remote_message::tile, &state.region, sizeof(state.region)))
+				{
+					if (state.copies == 0)
+					{
+						pending.push_back(index);
+					}
+					drop(*worker);
+					break;
+				}
+				if (state.copies++ == 0)
+				{
+					state.issued = clock::now();
+				}
+				worker->tiles.push_back(index);
+			}
+			if (worker->link.is_open())
+			{
+				auto entry = socket_poll();
+				entry.fd = worker->link.get_handle();
+				entry.events = POLLIN;
+				polls.push_back(entry);
+				polled.push_back(worker.get());
+			}
+		}
+		if (polls.empty())
+		{
+			fprintf(stderr, "Error: every worker is gone, %zu of %zu tiles are missing\n", tiles.size() - completed, tiles.size());
+			return false;
+		}
+		// wakes up now and then to look for stragglers even when nothing arrives
+		if (!poll_sockets(polls.data(), polls.size(), 100))
+		{
+			fprintf(stderr, "Error: could not wait for the workers\n");
+			return false;
+		}
+		const auto now = clock::now();
+		const auto average = completed == 0 ? 0.0 : std::chrono::duration<double>(round_trips).count() / double(completed);
+		const auto silence = std::max(remote_silence_timeout, remote_silence_factor * average);
+		for (auto i = size_t(0); i < polls.size(); i++)
+		{
+			auto& worker = *polled[i];
+			if (polls[i].revents != 0 && !receive(worker))
+			{
+				drop(worker);
+				continue;
+			}
+			// one that has not said hello yet owes a message as much as one holding tiles does
+			const auto quiet = std::chrono::duration<double>(now - worker.heard).count();
+			if (!worker.inbox.empty() && std::chrono::duration<double>(now - worker.partial_since).count() > remote_receive_timeout)
+			{
+				fprintf(stderr, "a worker stalled in the middle of a result\n");
+				drop(worker);
+			}
+			else if ((worker.capacity == 0 || !worker.tiles.empty()) && quiet > (worker.returned_any ? silence : remote_startup_timeout))
+			{
+				fprintf(stderr, "a worker has been quiet for %.0f seconds\n", quiet);
+				drop(worker);
+			}
+		}
+	}
+
+	for (auto& worker : workers)
+	{
+		if (worker->link.is_open())
+		{
+			send_message(worker->link, remote_message::done, nullptr, 0);
+		}
+	}
+	return true;
+}
+
+// connects to the coordinator at host:port, retrying for a while so workers can be started first, and renders the tiles it
+// hands out, a batch at a time, until it says the frame is done
+inline int run_worker(const char* host, const int port, unsigned threads)
+{
+	if (threads == 0)
+	{
+		threads = tile_scheduler::default_threads();
+	}
+	connection link;
+	for (auto attempt = 0; !link.open(host, port); attempt++)
+	{
+		if (attempt == 100)
+		{
+			fprintf(stderr, "Error: no coordinator at %s:%d\n", host, port);
+			return EXIT_FAILURE;
+		}
+		std::this_thread::sleep_for(std::chrono::milliseconds(100));
+	}
+
+	const auto hello = remote_hello{ threads };
+	auto header = remote_header();
+	auto job = remote_job();
+	if (!send_message(link, remote_message::hello, &hello, sizeof(hello)) || !link.receive(&header, sizeof(header)) || header.type != remote_message::job)
+	{
+		fprintf(stderr, "Error: the coordinator sent no job\n");
+		return EXIT_FAILURE;
+	}
+	if (header.protocol != remote_protocol)
+	{
+		fprintf(stderr, "Error: the coordinator speaks protocol %u, this worker %u\n", unsigned(header.protocol), unsigned(remote_protocol));
+		return EXIT_FAILURE;
+	}
+	if (header.size < sizeof(job) || !link.receive(&job, sizeof(job)))
+	{
+		fprintf(stderr, "Error: the coordinator sent no job\n");
+		return EXIT_FAILURE;
+	}
+	if (header.size - sizeof(job) > uint64_t(SIZE_MAX))
+	{
+		fprintf(stderr, "Error: the scene is too large for this worker\n");
+		return EXIT_FAILURE;
+	}
+	const auto size = size_t(header.size - sizeof(job));
+	const auto packed = std::make_shared<std::vector<scene_chunk>>((size + sizeof(scene_chunk) - 1) / sizeof(scene_chunk));
+	const auto data = reinterpret_cast<const unsigned char*>(packed->data());
+	if (!link.receive(packed->data(), size))
+	{
+		fprintf(stderr, "Error: lost the coordinator while receiving the scene\n");
+		return EXIT_FAILURE;
+	}
+	const auto world = std::unique_ptr<scene>(read_scene_binary(packed, data, size, "the coordinator's scene"));
+	if (world == nullptr || job.width <= 0 || job.height <= 0 || job.samples <= 0)
+	{
+		return EXIT_FAILURE;
+	}
+	auto limits = trace_limits();
+	limits.max_depth = job.max_depth;
+	limits.min_contribution = job.min_contribution;
+	limits.roulette_depth = job.roulette_depth;
+	limits.roulette_weight = job.roulette_weight;
+	const auto renderer = std::unique_ptr<tracer>(open_tracer(world.get(), limits));
+	auto frame = image(job.width, job.height);
+	auto sums = std::vector<vec3>(size_t(job.width) * job.height);
+	auto pixels = std::vector<vec3>();
+
+	const auto lost = []()
+	{
+		fprintf(stderr, "Error: lost the coordinator\n");
+		return EXIT_FAILURE;
+	};
+	// waits for a tile, then takes the ones already waiting behind it up to a batch, which the threads render together
+	const auto batch = remote_batch_size(threads);
+	auto held = std::vector<remote_tile>();
+	auto regions = std::vector<tile>();
+	for (;;)
+	{
+		held.clear();
+		while (held.size() < batch && (held.empty() || link.wait(0)))
+		{
+			auto region = remote_tile();
+			if (!link.receive(&header, sizeof(header)))
+			{
+				return lost();
+			}
+			if (header.type == remote_message::done)
+			{
+				return EXIT_SUCCESS;
+			}
+			if (header.type != remote_message::tile || header.size != sizeof(region) || !link.receive(&region, sizeof(region)))
+			{
+				return lost();
+			}
+			if (region.x < 0 || region.y < 0 || region.width <= 0 || region.height <= 0 || region.x + region.width > job.width || region.y + region.height > job.height)
+			{
+				fprintf(stderr, "Error: the coordinator sent a tile outside the image\n");
+				return EXIT_FAILURE;
+			}
+			held.push_back(region);
+		}
+
+		PROFILE_SCOPE("remote batch");
+		regions.clear();
+		for (const auto& region : held)
+		{
+			for (auto y = region.y; y < region.y + region.height; y++)
+			{
+				std::fill_n(sums.begin() + size_t(y) * job.width + region.x, region.width, vec3(0.0f));
+			}
+			regions.push_back({ region.x, region.y, region.width, region.height });
+		}
+		renderer->render_regions(regions, &frame, sums.data(), job.samples, threads);
+		for (const auto& region : held)
+		{
+			pixels.clear();
+			for (auto y = region.y; y < region.y + region.height; y++)
+			{
+				for (auto x = region.x; x < region.x + region.width; x++)
+				{
+					pixels.push_back(frame.get_pixel(x, y));
+				}
+			}
+			if (!send_message(link, remote_message::result, &region, sizeof(region), pixels.data(), pixels.size() * sizeof(vec3)))
+			{
+				return lost();
+			}
+		}
+	}
+}
+#endif
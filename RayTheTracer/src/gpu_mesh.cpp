@@ -0,0 +1,110 @@
+// Vertex buffer and vertex array of one mesh, uploaded once and afterwards only bound and drawn.
+// Nothing is created until the first upload, so shapes built without a GL context (headless, benchmark) never call into GL.
+#ifndef GPU_MESH_H
+#define GPU_MESH_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <../src/structs.cpp>
+
+class gpu_mesh
+{
+	GLuint vertex_array_;
+	GLuint vertex_buffer_;
+	GLuint index_buffer_;
+	// vertices for glDrawArrays, indices when index_buffer_ is set
+	int count_;
+
+public:
+	gpu_mesh() : vertex_array_(0), vertex_buffer_(0), index_buffer_(0), count_(0) {}
+
+	gpu_mesh(const gpu_mesh&) = delete;
+	gpu_mesh& operator=(const gpu_mesh&) = delete;
+
+	bool is_uploaded() const
+	{
+		return this->vertex_array_ != 0;
+	}
+
+	// vertices are interleaved groups of attributes points, attribute i goes to shader location i;
+	// the buffer is never respecified, so drivers keep it in video memory
+	void upload(const point* vertices, const int number_of_vertices, const int attributes)
+	{
+		this->count_ = number_of_vertices;
+		glGenVertexArrays(1, &this->vertex_array_);
+		glBindVertexArray(this->vertex_array_);
+		glGenBuffers(1, &this->vertex_buffer_);
+		glBindBuffer(GL_ARRAY_BUFFER, this->vertex_buffer_);
+		glBufferData(GL_ARRAY_BUFFER, sizeof(point) * number_of_vertices * attributes, vertices, GL_STATIC_DRAW);
+		for (auto i = 0; i < attributes; i++)
+		{
+			glVertexAttribPointer(i, 3, GL_FLOAT, GL_FALSE, 3 * attributes * sizeof(float), reinterpret_cast<void*>(3 * i * sizeof(float)));
+			glEnableVertexAttribArray(i);
+		}
+		glBindVertexArray(0);
+	}
+
+	// positions go to location 0 and normals to location 2; without normals the position is used as the normal
+	void upload(const array_view<glm::vec3> positions, const array_view<glm::vec3> normals, const array_view<unsigned> indices)
+	{
+		const auto positions_size = sizeof(glm::vec3) * positions.size();
+		const auto normals_size = sizeof(glm::vec3) * normals.size();
+		this->count_ = int(indices.size());
+		glGenVertexArrays(1, &this->vertex_array_);
+		glBindVertexArray(this->vertex_array_);
+		glGenBuffers(1, &this->vertex_buffer_);
+		glBindBuffer(GL_ARRAY_BUFFER, this->vertex_buffer_);
+		glBufferData(GL_ARRAY_BUFFER, positions_size + normals_size, nullptr, GL_STATIC_DRAW);
+		glBufferSubData(GL_ARRAY_BUFFER, 0, positions_size, positions.data());
+		if (!normals.empty())
+		{
+			glBufferSubData(GL_ARRAY_BUFFER, positions_size, normals_size, normals.data());
+		}
+		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(glm::vec3), nullptr);
+		glEnableVertexAttribArray(0);
+		glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, sizeof(glm::vec3), reinterpret_cast<void*>(normals.empty() ? 0 : positions_size));
+		glEnableVertexAttribArray(2);
+		glGenBuffers(1, &this->index_buffer_);
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, this->index_buffer_);
+		glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(unsigned) * indices.size(), indices.data(), GL_STATIC_DRAW);
+		glBindVertexArray(0);
+	}
+
+	void bind() const
+	{
+		glBindVertexArray(this->vertex_array_);
+	}
+
+	void draw(const GLenum mode) const
+	{
+		this->bind();
+		this->draw_bound(mode);
+	}
+
+	// assumes this mesh's vertex array is the one bound
+	void draw_bound(const GLenum mode) const
+	{
+		if (this->index_buffer_ != 0)
+		{
+			glDrawElements(mode, this->count_, GL_UNSIGNED_INT, nullptr);
+		}
+		else
+		{
+			glDrawArrays(mode, 0, this->count_);
+		}
+	}
+
+	~gpu_mesh()
+	{
+		if (this->is_uploaded())
+		{
+			glDeleteBuffers(1, &this->vertex_buffer_);
+			if (this->index_buffer_ != 0)
+			{
+				glDeleteBuffers(1, &this->index_buffer_);
+			}
+			glDeleteVertexArrays(1, &this->vertex_array_);
+		}
+	}
+};
+#endif
@@ -0,0 +1,115 @@
+#ifndef IMAGE_H
+#define IMAGE_H
+
+#include <../src/profiler.cpp>
+#include <glm/glm.hpp>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+using namespace glm;
+
+// what the primary rays of a pixel hit first, averaged over its samples and zero where they missed; the guides an edge
+// aware filter uses to tell noise from detail
+struct pixel_features
+{
+	vec3 normal;
+	vec3 albedo;
+	// distance along the primary ray
+	float depth;
+	// of the pixel's mean luminance, from how far its samples spread; 0 with a single sample
+	float variance;
+};
+
+// linear rgb frame buffer the CPU ray tracer renders into, row 0 is the top of the image
+class image
+{
+	int width_;
+	int height_;
+	std::vector<vec3> pixels_;
+
+public:
+	image(const int width, const int height) : width_(width), height_(height), pixels_(width * height)
+	{
+	}
+
+	int get_width() const
+	{
+		return this->width_;
+	}
+
+	int get_height() const
+	{
+		return this->height_;
+	}
+
+	void set_pixel(const int x, const int y, const vec3 color)
+	{
+		this->pixels_[y * this->width_ + x] = color;
+	}
+
+	vec3 get_pixel(const int x, const int y) const
+	{
+		return this->pixels_[y * this->width_ + x];
+	}
+
+	// width * height pixels, row by row from the top
+	const vec3* get_pixels() const
+	{
+		return this->pixels_.data();
+	}
+
+	// binary PPM, no dependencies and every viewer understands it
+	bool write(const char* path) const
+	{
+		PROFILE_SCOPE("write image");
+		std::ofstream file(path, std::ios::binary);
+		if (!file)
+		{
+			std::cout << "ERROR::IMAGE::FILE_NOT_SUCCESFULLY_WRITTEN" << std::endl;
+			return false;
+		}
+		file << "P6\n" << this->width_ << " " << this->height_ << "\n255\n";
+		auto row = std::vector<unsigned char>(this->width_ * 3);
+		for (auto y = 0; y < this->height_; y++)
+		{
+			for (auto x = 0; x < this->width_; x++)
+			{
+				const auto color = clamp(this->get_pixel(x, y), 0.0f, 1.0f);
+				row[x * 3] = static_cast<unsigned char>(color.r * 255.0f + 0.5f);
+				row[x * 3 + 1] = static_cast<unsigned char>(color.g * 255.0f + 0.5f);
+				row[x * 3 + 2] = static_cast<unsigned char>(color.b * 255.0f + 0.5f);
+			}
+			file.write(reinterpret_cast<const char*>(row.data()), row.size());
+		}
+		return file.good();
+	}
+};
+
+// writes prefix_normal.ppm with normals mapped to [0, 1], prefix_albedo.ppm and prefix_depth.ppm scaled so the farthest hit is white
+inline bool write_features(const char* prefix, const pixel_features* features, const int width, const int height)
+{
+	PROFILE_SCOPE("write features");
+	auto normals = image(width, height);
+	auto albedos = image(width, height);
+	auto depths = image(width, height);
+	auto farthest = 0.0f;
+	for (auto i = 0; i < width * height; i++)
+	{
+		farthest = max(farthest, features[i].depth);
+	}
+	for (auto y = 0; y < height; y++)
+	{
+		for (auto x = 0; x < width; x++)
+		{
+			const auto& feature = features[y * width + x];
+			normals.set_pixel(x, y, feature.normal * 0.5f + 0.5f);
+			albedos.set_pixel(x, y, feature.albedo);
+			depths.set_pixel(x, y, vec3(farthest > 0.0f ? feature.depth / farthest : 0.0f));
+		}
+	}
+	const auto name = std::string(prefix);
+	return normals.write((name + "_normal.ppm").c_str()) && albedos.write((name + "_albedo.ppm").c_str()) && depths.write((name + "_depth.ppm").c_str());
+}
+#endif
@@ -0,0 +1,65 @@
+// Shows a CPU rendered image in the window: the pixels go to a float texture that a single triangle stretches over the whole
+// viewport. Like gpu_mesh nothing is created until the first upload, so it costs nothing in a headless run.
+#ifndef IMAGE_VIEW_H
+#define IMAGE_VIEW_H
+
+#include <glad/glad.h>
+#include <../headers/shaders.hpp>
+#include <../src/image.cpp>
+
+class image_view
+{
+	GLuint texture_;
+	// empty, the triangle's corners come from gl_VertexID, but a core context draws nothing without one bound
+	GLuint vertex_array_;
+	int width_;
+	int height_;
+
+public:
+	image_view() : texture_(0), vertex_array_(0), width_(0), height_(0) {}
+
+	image_view(const image_view&) = delete;
+	image_view& operator=(const image_view&) = delete;
+
+	// the texture is only respecified when the size changes
+	void upload(const image* source)
+	{
+		if (this->texture_ == 0)
+		{
+			glGenTextures(1, &this->texture_);
+			glGenVertexArrays(1, &this->vertex_array_);
+		}
+		glBindTexture(GL_TEXTURE_2D, this->texture_);
+		if (source->get_width() != this->width_ || source->get_height() != this->height_)
+		{
+			this->width_ = source->get_width();
+			this->height_ = source->get_height();
+			glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB32F, this->width_, this->height_, 0, GL_RGB, GL_FLOAT, nullptr);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		}
+		glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, this->width_, this->height_, GL_RGB, GL_FLOAT, source->get_pixels());
+	}
+
+	// draws the last upload with shader, which samples texture unit 0
+	void draw(const shaders* shader) const
+	{
+		shader->use();
+		glActiveTexture(GL_TEXTURE0);
+		glBindTexture(GL_TEXTURE_2D, this->texture_);
+		glBindVertexArray(this->vertex_array_);
+		glDrawArrays(GL_TRIANGLES, 0, 3);
+	}
+
+	~image_view()
+	{
+		if (this->texture_ != 0)
+		{
+			glDeleteTextures(1, &this->texture_);
+			glDeleteVertexArrays(1, &this->vertex_array_);
+		}
+	}
+};
+#endif
@@ -0,0 +1,284 @@
+// Two level acceleration structure: a bottom level hierarchy per unique mesh, in the mesh's local space, and instances that
+// place one of them in the world with a model matrix. Rays are moved into object space with the inverse model matrix and
+// keep their parametrisation, so hit distances compare directly across instances.
+#ifndef INSTANCES_H
+#define INSTANCES_H
+
+#include <../src/shapes.cpp>
+#include <../src/simd.cpp>
+#include <algorithm>
+#include <vector>
+
+class mesh_bvh
+{
+	// stored in the order of the hierarchy's leaves; surface is left null, instances supply it
+	std::vector<triangle> triangles_;
+	bvh tree_;
+	// the same triangles in blocks of up to 8 per leaf for the single ray kernel, indexed by the block's first triangle
+	std::vector<triangle_block> blocks_;
+	std::vector<int> block_index_;
+
+	void build_blocks()
+	{
+		this->blocks_.clear();
+		this->block_index_.assign(this->triangles_.size(), -1);
+		for (const auto& node : this->tree_.get_nodes())
+		{
+			if (!node.is_leaf())
+			{
+				continue;
+			}
+			for (auto first = node.first; first < node.first + node.count; first += packet_width)
+			{
+				this->block_index_[first] = int(this->blocks_.size());
+				this->blocks_.emplace_back(&this->triangles_[first], std::min(packet_width, node.first + node.count - first));
+			}
+		}
+	}
+
+public:
+	// one triangle per index triple, in index order; a stored hierarchy's order refers to this list
+	static std::vector<triangle> make_triangles(const mesh* geometry)
+	{
+		const auto positions = geometry->get_positions();
+		const auto indices = geometry->get_indices();
+		auto triangles = std::vector<triangle>();
+		triangles.reserve(indices.size() / 3);
+		for (auto i = size_t(0); i + 2 < indices.size(); i += 3)
+		{
+			const auto a = indices[i];
+			const auto b = indices[i + 1];
+			const auto c = indices[i + 2];
+			triangles.emplace_back(positions[a], positions[b], positions[c],
+				normalize(geometry->get_normal(a)), normalize(geometry->get_normal(b)), normalize(geometry->get_normal(c)), nullptr);
+		}
+		return triangles;
+	}
+
+	explicit mesh_bvh(const mesh* geometry) : triangles_(make_triangles(geometry))
+	{
+		const auto nodes = geometry->get_hierarchy_nodes();
+		const auto order = geometry->get_hierarchy_order();
+		if (!nodes.empty() && order.size() == this->triangles_.size())
+		{
+			this->tree_.assign(nodes.data(), nodes.size(), order.data(), order.size());
+			auto ordered = std::vector<triangle>();
+			ordered.reserve(this->triangles_.size());
+			for (const auto index : order)
+			{
+				ordered.push_back(this->triangles_[index]);
+			}
+			this->triangles_.swap(ordered);
+		}
+		else
+		{
+			build_tree(this->triangles_, this->tree_);
+		}
+		this->build_blocks();
+	}
+
+	mesh_bvh(const mesh_bvh&) = delete;
+	mesh_bvh& operator=(const mesh_bvh&) = delete;
+
+	const triangle& get_triangle(const int index) const
+	{
+		return this->triangles_[index];
+	}
+
+	int get_triangle_count() const
+	{
+		return int(this->triangles_.size());
+	}
+
+	aabb bounds() const
+	{
+		auto box = aabb();
+		if (!this->tree_.get_nodes().empty())
+		{
+			box.grow(this->tree_.get_nodes()[0].minimum);
+			box.grow(this->tree_.get_nodes()[0].maximum);
+		}
+		return box;
+	}
+
+	size_t get_memory_usage() const
+	{
+		return this->triangles_.capacity() * sizeof(triangle)
+			+ this->blocks_.capacity() * sizeof(triangle_block)
+			+ this->block_index_.capacity() * sizeof(int)
+			+ this->tree_.get_memory_usage();
+	}
+
+	// record.position, normal and surface come back in object space and without a material
+	bool intersect(const ray& r, intersection& record) const
+	{
+		const auto& kernels = active_kernels();
+		return this->tree_.intersect(r, record, [this, &kernels](const int first, const int count, const ray& leaf_ray, intersection& leaf_record)
+		{
+			PROFILE_COUNT(triangle_tests, count);
+			auto found = false;
+			for (auto chunk = first; chunk < first + count; chunk += packet_width)
+			{
+				const auto hit = kernels.intersect_block(this->blocks_[this->block_index_[chunk]], leaf_ray, leaf_record.distance);
+				if (hit.lane >= 0)
+				{
+					this->triangles_[chunk + hit.lane].fill(leaf_ray, hit.distance, hit.u, hit.v, leaf_record);
+					found = true;
+				}
+			}
+			return found;
+		});
+	}
+
+	// any hit of r closer than max_distance, in object space
+	bool occluded(const ray& r, const float max_distance) const
+	{
+		const auto& kernels = active_kernels();
+		return this->tree_.occluded(r, max_distance, [this, &kernels, max_distance](const int first, const int count, const ray& leaf_ray)
+		{
+			PROFILE_COUNT(triangle_tests, count);
+			for (auto chunk = first; chunk < first + count; chunk += packet_width)
+			{
+				if (kernels.intersect_block(this->blocks_[this->block_index_[chunk]], leaf_ray, max_distance).lane >= 0)
+				{
+					return true;
+				}
+			}
+			return false;
+		});
+	}
+
+	void intersect_packet(ray_packet& packet, const simd_kernels& kernels) const
+	{
+		const auto test_node = [&kernels](const ray_packet& leaf_packet, const bvh_node& node)
+		{
+			return kernels.intersect_packet_box(leaf_packet, node);
+		};
+		this->tree_.intersect_packet(packet, test_node, [this, &kernels](const int first, const int count, ray_packet& leaf_packet)
+		{
+			PROFILE_COUNT(triangle_tests, count);
+			for (auto i = first; i < first + count; i++)
+			{
+				kernels.intersect_packet_triangle(leaf_packet, this->triangles_[i], i);
+			}
+		});
+	}
+};
+
+struct instance
+{
+	const mesh_bvh* geometry;
+	const material* surface;
+	const shape* source;
+	// the source's model matrix when it was last placed
+	mat4 model;
+	mat4 to_object;
+	mat3 to_object_direction;
+	mat3 normal_matrix;
+	aabb box;
+
+	instance(const mesh_bvh* geometry, const shape* source) :
+		geometry(geometry),
+		surface(source->get_material()),
+		source(source)
+	{
+		this->place(source->get_model());
+	}
+
+	// only the matrices and the world box change when the shape moves, the mesh hierarchy stays as it is
+	void place(const mat4& model)
+	{
+		this->model = model;
+		this->to_object = inverse(model);
+		this->to_object_direction = mat3(this->to_object);
+		this->normal_matrix = transpose(this->to_object_direction);
+		const auto local = this->geometry->bounds();
+		this->box = aabb();
+		for (auto corner = 0; corner < 8; corner++)
+		{
+			const auto position = vec3(
+				(corner & 1) != 0 ? local.maximum.x : local.minimum.x,
+				(corner & 2) != 0 ? local.maximum.y : local.minimum.y,
+				(corner & 4) != 0 ? local.maximum.z : local.minimum.z);
+			this->box.grow(vec3(model * vec4(position, 1.0f)));
+		}
+	}
+
+	aabb bounds() const
+	{
+		return this->box;
+	}
+
+	// the direction is not renormalised so a distance along it is the same distance along r
+	ray to_local(const ray& r) const
+	{
+		return ray(vec3(this->to_object * vec4(r.origin, 1.0f)), this->to_object_direction * r.direction);
+	}
+
+	bool intersect(const ray& r, intersection& record) const
+	{
+		if (!this->geometry->intersect(this->to_local(r), record))
+		{
+			return false;
+		}
+		this->to_world(r, record);
+		return true;
+	}
+
+	// distances along the local ray are distances along r, so max_distance carries over as it is
+	bool occludes(const ray& r, const float max_distance) const
+	{
+		return this->geometry->occluded(this->to_local(r), max_distance);
+	}
+
+	// hit of r on one of the mesh's triangles, as found by a packet
+	void fill(const ray& r, const int triangle_index, const float distance, const float u, const float v, intersection& record) const
+	{
+		this->geometry->get_triangle(triangle_index).fill(r, distance, u, v, record);
+		this->to_world(r, record);
+	}
+
+	// runs the packet through the mesh in object space and copies back every lane that found a closer hit
+	void intersect_packet(ray_packet& packet, const int index, const simd_kernels& kernels) const
+	{
+		auto local = packet;
+		for (auto lane = 0; lane < packet_width; lane++)
+		{
+			const auto origin = vec3(this->to_object * vec4(packet.origin_x[lane], packet.origin_y[lane], packet.origin_z[lane], 1.0f));
+			const auto direction = this->to_object_direction * vec3(packet.direction_x[lane], packet.direction_y[lane], packet.direction_z[lane]);
+			local.origin_x[lane] = origin.x;
+			local.origin_y[lane] = origin.y;
+			local.origin_z[lane] = origin.z;
+			local.direction_x[lane] = direction.x;
+			local.direction_y[lane] = direction.y;
+			local.direction_z[lane] = direction.z;
+			local.inverse_x[lane] = 1.0f / direction.x;
+			local.inverse_y[lane] = 1.0f / direction.y;
+			local.inverse_z[lane] = 1.0f / direction.z;
+		}
+		local.mean_direction = this->to_object_direction * packet.mean_direction;
+		this->geometry->intersect_packet(local, kernels);
+		for (auto lane = 0; lane < packet_width; lane++)
+		{
+			if (local.distance[lane] < packet.distance[lane])
+			{
+				packet.distance[lane] = local.distance[lane];
+				packet.u[lane] = local.u[lane];
+				packet.v[lane] = local.v[lane];
+				packet.triangle[lane] = local.triangle[lane];
+				packet.sphere[lane] = -1;
+				packet.instance[lane] = index;
+			}
+		}
+	}
+
+private:
+	// position from the world ray, normal through the inverse transpose, material from the instance
+	void to_world(const ray& r, intersection& record) const
+	{
+		record.position = r.at(record.distance);
+		record.normal = normalize(this->normal_matrix * record.normal);
+		record.surface = this->surface;
+	}
+};
+#endif
@@ -1,55 +1,66 @@
-#include <../src/shapes.cpp>
-
-class light
-{
-	sphere* lamp_;
-	light_properties* light_props_;
-
-public:
-	light(const vec3 location)
-	{
-		const auto light_color = vec3(1.0f, 1.0f, 1.0f);
-		this->light_props_ = new light_properties(light_color * vec3(0.2f), light_color * vec3(0.5f), light_color);
-		const auto lights = new material(0.0f, 0.0f, 1.0f, light_props_->specular_color);
-		this->lamp_ = new sphere(lights, 20);
-		this->lamp_->translate(location, true);
-		this->lamp_->scale(vec3(0.05f, 0.05f, 0.05f), true);
-	}
-
-	void rotate(const float angle, const vec3 axis) const
-	{
-		this->lamp_->rotate(angle, axis, false);
-	}
-
-	void translate(const vec3 direction) const
-	{
-		this->lamp_->translate(direction, false);
-	}
-
-
-	void scale(const vec3 magnitude) const
-	{
-		this->lamp_->scale(magnitude, false);
-	}
-
-	vec3 get_location() const
-	{
-		return this->lamp_->get_centre();
-	}
-
-	light_properties* get_properties() const
-	{
-		return this->light_props_;
-	}
-
-	void draw(shaders* shader) const
-	{
-		this->lamp_->draw(shader);
-	}
-
-	~light()
-	{
-		delete this->lamp_;
-		delete this->light_props_;
-	}
-};
\ No newline at end of file
+#ifndef LIGHT_H
+#define LIGHT_H
+
+#include <../src/shapes.cpp>
+
+class light
+{
+	// declared before lamp_, which points at it
+	material lamp_material_;
+	sphere* lamp_;
+	light_properties* light_props_;
+
+public:
+	light(const vec3 location) : lamp_material_(0.0f, 0.0f, 1.0f, vec3(1.0f, 1.0f, 1.0f))
+	{
+		const auto light_color = vec3(1.0f, 1.0f, 1.0f);
+		this->light_props_ = new light_properties(light_color * vec3(0.2f), light_color * vec3(0.5f), light_color);
+		this->lamp_ = new sphere(&this->lamp_material_, 20);
+		this->lamp_->translate(location);
+		this->lamp_->scale(vec3(0.05f, 0.05f, 0.05f));
+	}
+
+	void rotate(const float angle, const vec3 axis) const
+	{
+		this->lamp_->rotate(angle, axis);
+	}
+
+	void translate(const vec3 direction) const
+	{
+		this->lamp_->translate(direction);
+	}
+
+
+	void scale(const vec3 magnitude) const
+	{
+		this->lamp_->scale(magnitude);
+	}
+
+	vec3 get_location() const
+	{
+		return this->lamp_->get_centre();
+	}
+
+	// changes whenever the lamp moves
+	unsigned get_version() const
+	{
+		return this->lamp_->get_version();
+	}
+
+	light_properties* get_properties() const
+	{
+		return this->light_props_;
+	}
+
+	void draw(render_queue* queue, const shaders* shader) const
+	{
+		this->lamp_->draw(queue, shader);
+	}
+
+	~light()
+	{
+		delete this->lamp_;
+		delete this->light_props_;
+	}
+};
+#endif
\ No newline at end of file
@@ -1,229 +1,544 @@
-#include <glad/glad.h>
-#include <GLFW/glfw3.h>
-#include <glm/glm.hpp>
-#include <glm/ext.hpp>
-
-#include <../headers/shaders.hpp>
-#include <../src/light.cpp>
-#include <../src/camera.cpp>
-#include <cstdlib>
-#include <cstdio>
-
-const unsigned int scr_width = 800;
-const unsigned int scr_height = 800;
-
-static void error_callback(const int error, const char* description)
-{
-	fprintf(stderr, "Error: %d\n", error);
-	fprintf(stderr, "Error: %s\n", description);
-}
-
-
-static void close_window_callback(GLFWwindow* window, const int key, int scancode, const int action, int mods)
-{
-	if (key == GLFW_KEY_ESCAPE && action == GLFW_PRESS)
-		glfwSetWindowShouldClose(window, GLFW_TRUE);
-}
-
-void framebuffer_size_callback(GLFWwindow* window, int width, int height)
-{
-	// make sure the viewport matches the new window dimensions; note that width and 
-	// height will be significantly larger than specified on retina displays.
-	glViewport(0, 0, width, height);
-}
-
-GLFWwindow* init()
-{
-	glfwSetErrorCallback(error_callback);
-	if (!glfwInit())
-		exit(EXIT_FAILURE);
-	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 2);
-	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 0);
-	const auto window = glfwCreateWindow(scr_width, scr_height, "Ray the tracer", nullptr, nullptr);
-	if (!window)
-	{
-		glfwTerminate();
-		exit(EXIT_FAILURE);
-	}
-	glfwSetKeyCallback(window, close_window_callback);
-	glfwMakeContextCurrent(window);
-	glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
-
-	return window;
-}
-
-void draw_coordinate_system()
-{
-	point x_axis[] = {
-		point(-2.0f, 0.0f, 0.0f), point(0.0f, 0.0f, 0.0f),
-		point(2.0f, 0.0f, 0.0f), point(0.9f, 0.2f, 0.1f)
-	};// x is RED
-
-	point y_axis[] = {
-		point(0.0f, -2.0f, 0.0f), point(0.0f, 0.0f, 0.0f),
-		point(0.0f, 2.0f, 0.0f), point(0.1f, 0.9f, 0.1f),
-	};// y is GREEN
-
-	point z_axis[] = {
-		point(0.0f, 0.0f, -2.0f), point(0.0f, 0.0f, 0.0f),
-		point(0.0f, 0.0f, 2.0f), point(0.2f, 0.5f, 1.0f),
-	};// z is BLUE
-
-	glBufferData(GL_ARRAY_BUFFER, sizeof(x_axis), x_axis, GL_STATIC_DRAW);
-	glDrawArrays(GL_LINES, 0, 2);
-
-	glBufferData(GL_ARRAY_BUFFER, sizeof(y_axis), y_axis, GL_STATIC_DRAW);
-	glDrawArrays(GL_LINES, 0, 2);
-
-	glBufferData(GL_ARRAY_BUFFER, sizeof(z_axis), z_axis, GL_STATIC_DRAW);
-	glDrawArrays(GL_LINES, 0, 2);
-}
-
-void generate_vertex_array(GLuint *vertex_array, const int triplets)
-{
-	glGenVertexArrays(1, vertex_array);
-	glBindVertexArray(*vertex_array);
-	for (auto i = 0; i < triplets; i++)
-	{
-		glVertexAttribPointer(i, 3, GL_FLOAT, GL_FALSE, 3 * triplets * sizeof(float), reinterpret_cast<void*>(3 * i * sizeof(float)));
-		glEnableVertexAttribArray(i);
-	}
-}
-
-int main()
-{
-	auto const window = init();
-	// glad: load all OpenGL function pointers
-	// ---------------------------------------
-	if (!gladLoadGLLoader(GLADloadproc(glfwGetProcAddress)))
-	{
-		fprintf(stderr, "Error: %s\n", "Failed to initialize GLAD");
-		return -1;
-	}
-
-	// const auto shader_program = setup_shaders();
-	const auto general_shader = new shaders("./shaders/vertex_shader.vsh", "./shaders/fragment_shader.fsh");
-	const auto lighting_shader = new shaders("./shaders/lighting_shader.vsh", "./shaders/lighting_shader.fsh");
-	const auto axis_shader = new shaders("./shaders/axis_shader.vsh", "./shaders/axis_shader.fsh");
-	const auto cam = new camera();
-	//cam->rotate(-20.0f, vec3(1.0f, 0.0f, 0.0f));
-	//cam->rotate(30.0f, vec3(0.0f, 0.0f, 1.0f));
-	cam->scale(2.0f);
-
-	GLuint vertex_buffer, vertex_array, light_vertex_array, axis_array;
-	glGenBuffers(1, &vertex_buffer);
-
-	glBindBuffer(GL_ARRAY_BUFFER, vertex_buffer);
-
-	generate_vertex_array(&vertex_array, 3);
-	generate_vertex_array(&light_vertex_array, 3);
-	generate_vertex_array(&axis_array, 2);
-
-	glEnable(GL_DEPTH_TEST);
-
-	const auto light_position = vec3(1.4f, 1.4f, 1.4f);
-	auto light_world_position = vec3(light_position);
-
-	general_shader->use();
-	general_shader->feed_vec("light_pos", light_position);
-
-	const auto gold = new material(0.5f, 0.0f, 0.5f, vec3(1.0f, 0.83f, 0.3f));
-	const auto grey = new material(0.5f, 0.0f, 0.5f, vec3(0.5f, 0.5f, 0.5f));
-	const auto light_grey = new material(0.5f, 0.0f, 0.5f, vec3(0.8f, 0.8f, 0.8f));
-
-	const auto lamp = new light(light_position);
-
-	shape* rect = new cuboid(gold);
-	auto projection_plane = new wall(light_grey);
-	shape* sph = new sphere(gold, 100);
-	shape* floor = new wall(light_grey);
-	floor->translate(vec3(0.0f, 1.5f, -1.5f), true);
-	floor->scale(vec3(3.0f, 3.0f, 3.0f), true);
-
-	shape* far_wall = new wall(light_grey);
-	far_wall->translate(vec3(0.0f, 3.0f, 0.0f), true);
-	far_wall->rotate(90.0f, vec3(1.0f, 0.0f, 0.0f), true);
-	far_wall->scale(vec3(3.0f, 3.0f, 3.0f), true);
-
-	shape* left_wall = new wall(light_grey);
-	left_wall->translate(vec3(-1.5f, 1.5f, 0.0f), true);
-	left_wall->rotate(90.0f, vec3(0.0f, 1.0f, 0.0f), true);
-	left_wall->scale(vec3(3.0f, 3.0f, 3.0f), true);
-
-	projection_plane->rotate(90.0f, vec3(1.0f, 0.0f, 0.0f), true);
-	projection_plane->scale(vec3(5.3f, 5.3f, 5.3f), true);
-	std::cout << projection_plane->get_corner(0, 0).x << ", " << projection_plane->get_corner(0, 0).y << ", " << projection_plane->get_corner(0, 0).z << std::endl;
-	std::cout << projection_plane->get_corner(1, 0).x << ", " << projection_plane->get_corner(1, 0).y << ", " << projection_plane->get_corner(1, 0).z << std::endl;
-	std::cout << projection_plane->get_corner(0, 1).x << ", " << projection_plane->get_corner(0, 1).y << ", " << projection_plane->get_corner(0, 1).z << std::endl;
-	std::cout << projection_plane->get_corner(1, 1).x << ", " << projection_plane->get_corner(1, 1).y << ", " << projection_plane->get_corner(1, 1).z << std::endl;
-
-	sph->translate(vec3(-0.8f, 2.4f, -0.9f), true);
-	sph->scale(vec3(0.5f, 0.5f, 0.5f), true);
-
-	rect->translate(vec3(0.1f, 2.1f, -0.5f), true);
-	rect->scale(vec3(0.7f, 0.7f, 0.7f), true);
-
-
-	while (!glfwWindowShouldClose(window))
-	{
-		// render
-		glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
-		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-
-		glBindVertexArray(vertex_array);
-		 //cam->rotate(-0.06f, vec3(0.0f, 0.0f, 1.0f));
-		const auto proj_mat = perspective(radians(cam->get_angle()), float(scr_width) / float(scr_height), 0.1f, 100.0f);
-
-		general_shader->use();
-		general_shader->feed_mat("view", cam->get_view_matrix());
-		general_shader->feed_mat("projection", proj_mat);
-		general_shader->feed_vec("view_pos", cam->get_position());
-		general_shader->feed_vec("light.position", light_world_position);
-		general_shader->feed_vec("light.ambient", lamp->get_properties()->ambient_color);
-		general_shader->feed_vec("light.diffuse", lamp->get_properties()->diffusion_color);
-		general_shader->feed_vec("light.specular", lamp->get_properties()->specular_color);
-
-		//rect->rotate(float(glfwGetTime()) * 15.0f, vec3(0.0f, 0.0f, 1.0f));
-		rect->translate(vec3(1.4f, 0.0f, 0.0f));
-		sph->draw(general_shader);
-		rect->draw(general_shader);
-		floor->draw(general_shader);
-		far_wall->draw(general_shader);
-		left_wall->draw(general_shader);
-		//projection_plane->draw(general_shader);
-
-		glBindVertexArray(axis_array);
-		axis_shader->use();
-		axis_shader->feed_mat("view", cam->get_view_matrix());
-		axis_shader->feed_mat("projection", proj_mat);
-		axis_shader->feed_mat("model", mat4(1.0f));
-		draw_coordinate_system();
-
-		glBindVertexArray(light_vertex_array);
-		lighting_shader->use();
-		lighting_shader->feed_mat("view", cam->get_view_matrix());
-		lighting_shader->feed_mat("projection", proj_mat);
-
-		light_world_position = lamp->get_location();
-		lamp->draw(lighting_shader);
-
-		glfwSwapBuffers(window);
-		glfwPollEvents();
-	}
-
-	delete rect;
-	delete projection_plane;
-	delete sph;
-	delete gold;
-	delete grey;
-	delete light_grey;
-	delete lamp;
-	delete cam;
-	delete general_shader;
-	delete lighting_shader;
-	delete axis_shader;
-
-	glfwDestroyWindow(window);
-	glfwTerminate();
-	exit(EXIT_SUCCESS);
-}
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+#include <glm/glm.hpp>
+#include <glm/ext.hpp>
+
+#include <../headers/shaders.hpp>
+#include <../src/scene.cpp>
+#include <../src/tracer.cpp>
+#include <../src/benchmark.cpp>
+#include <../src/scene_file.cpp>
+#include <../src/accumulator.cpp>
+#include <../src/image_view.cpp>
+#include <../src/distributed.cpp>
+#include <../src/denoise.cpp>
+#include <../src/profiler.cpp>
+#include <cstdlib>
+#include <cstdio>
+#include <cstring>
+
+const unsigned int scr_width = 800;
+const unsigned int scr_height = 800;
+// where the ray traced view stops refining a still picture
+const int progressive_samples = 1024;
+// --animate swings a shape this far to either side of where it started, once every animation_period seconds
+const float animation_swing = 0.5f;
+const double animation_period = 4.0;
+
+// what the keys act on
+struct preview_state
+{
+	camera* cam;
+	light* lamp;
+	// ray traced instead of rasterised
+	bool traced;
+};
+
+static void error_callback(const int error, const char* description)
+{
+	fprintf(stderr, "Error: %d\n", error);
+	fprintf(stderr, "Error: %s\n", description);
+}
+
+
+// T switches between the rasterised and the ray traced view, the arrows orbit and zoom the camera, W A S D Q E move the lamp
+static void key_callback(GLFWwindow* window, const int key, int scancode, const int action, int mods)
+{
+	if (key == GLFW_KEY_ESCAPE && action == GLFW_PRESS)
+		glfwSetWindowShouldClose(window, GLFW_TRUE);
+	const auto state = static_cast<preview_state*>(glfwGetWindowUserPointer(window));
+	if (state == nullptr || action == GLFW_RELEASE)
+		return;
+	switch (key)
+	{
+	case GLFW_KEY_T:
+		if (action == GLFW_PRESS)
+			state->traced = !state->traced;
+		break;
+	case GLFW_KEY_LEFT:
+		state->cam->rotate(-5.0f, vec3(0.0f, 0.0f, 1.0f));
+		break;
+	case GLFW_KEY_RIGHT:
+		state->cam->rotate(5.0f, vec3(0.0f, 0.0f, 1.0f));
+		break;
+	case GLFW_KEY_UP:
+		state->cam->scale(0.95f);
+		break;
+	case GLFW_KEY_DOWN:
+		state->cam->scale(1.05f);
+		break;
+	// the lamp's sphere is scaled to a twentieth, so 2 of its units are 0.1 in the world
+	case GLFW_KEY_W:
+		state->lamp->translate(vec3(0.0f, 2.0f, 0.0f));
+		break;
+	case GLFW_KEY_S:
+		state->lamp->translate(vec3(0.0f, -2.0f, 0.0f));
+		break;
+	case GLFW_KEY_A:
+		state->lamp->translate(vec3(-2.0f, 0.0f, 0.0f));
+		break;
+	case GLFW_KEY_D:
+		state->lamp->translate(vec3(2.0f, 0.0f, 0.0f));
+		break;
+	case GLFW_KEY_Q:
+		state->lamp->translate(vec3(0.0f, 0.0f, -2.0f));
+		break;
+	case GLFW_KEY_E:
+		state->lamp->translate(vec3(0.0f, 0.0f, 2.0f));
+		break;
+	default:
+		break;
+	}
+}
+
+void framebuffer_size_callback(GLFWwindow* window, int width, int height)
+{
+	// make sure the viewport matches the new window dimensions; note that width and 
+	// height will be significantly larger than specified on retina displays.
+	glViewport(0, 0, width, height);
+}
+
+GLFWwindow* init()
+{
+	glfwSetErrorCallback(error_callback);
+	if (!glfwInit())
+		exit(EXIT_FAILURE);
+	// uniform blocks and the 330 core shaders need a 3.3 context, which llvmpipe provides
+	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+	const auto window = glfwCreateWindow(scr_width, scr_height, "Ray the tracer", nullptr, nullptr);
+	if (!window)
+	{
+		glfwTerminate();
+		exit(EXIT_FAILURE);
+	}
+	glfwSetKeyCallback(window, key_callback);
+	glfwMakeContextCurrent(window);
+	glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
+
+	return window;
+}
+
+// x is RED, y is GREEN, z is BLUE; uploaded to mesh on the first call
+void draw_coordinate_system(gpu_mesh* mesh)
+{
+	static const point axes[] = {
+		point(-2.0f, 0.0f, 0.0f), point(0.0f, 0.0f, 0.0f),
+		point(2.0f, 0.0f, 0.0f), point(0.9f, 0.2f, 0.1f),
+		point(0.0f, -2.0f, 0.0f), point(0.0f, 0.0f, 0.0f),
+		point(0.0f, 2.0f, 0.0f), point(0.1f, 0.9f, 0.1f),
+		point(0.0f, 0.0f, -2.0f), point(0.0f, 0.0f, 0.0f),
+		point(0.0f, 0.0f, 2.0f), point(0.2f, 0.5f, 1.0f)
+	};
+	if (!mesh->is_uploaded())
+	{
+		mesh->upload(axes, 6, 2);
+	}
+	mesh->draw(GL_LINES);
+}
+
+// the scene in scene_path, or the built in Cornell box when there is none
+scene* open_scene(const char* scene_path)
+{
+	PROFILE_SCOPE("open scene");
+	return scene_path == nullptr ? cornell_box() : load_scene(scene_path);
+}
+
+// casts the scene on the CPU and writes it out; never creates a window or a GL context. A positive threshold turns on adaptive
+// sampling with samples as the most any pixel gets, otherwise wavefront picks the breadth first renderer. With the plain
+// renderer the image can be denoised and the normal, albedo and depth buffers written next to it as features_prefix_*.ppm
+int render_headless(const char* scene_path, const char* output, const int width, const int height, const int samples, const unsigned threads,
+	const trace_limits& limits, const float threshold, const bool wavefront, const bool denoise, const char* features_prefix)
+{
+	const auto world = open_scene(scene_path);
+	if (world == nullptr)
+	{
+		return EXIT_FAILURE;
+	}
+	const auto renderer = open_tracer(world, limits);
+	const auto frame = new image(width, height);
+	if (threshold > 0.0f)
+	{
+		auto sampling = sampling_limits();
+		sampling.max_samples = samples;
+		sampling.min_samples = std::min(sampling.min_samples, samples);
+		sampling.threshold = threshold;
+		fprintf(stderr, "%.2f samples per pixel\n", renderer->render_adaptive(frame, sampling, threads));
+	}
+	else if (wavefront)
+	{
+		renderer->render_wavefront(frame, threads, samples);
+	}
+	else if (denoise || features_prefix != nullptr)
+	{
+		auto features = std::vector<pixel_features>(size_t(width) * height);
+		renderer->render(frame, threads, samples, features.data());
+		if (denoise)
+		{
+			denoiser().run(frame, features.data(), denoise_settings(), threads);
+		}
+		if (features_prefix != nullptr && !write_features(features_prefix, features.data(), width, height))
+		{
+			fprintf(stderr, "Error: could not write the features to %s_*.ppm\n", features_prefix);
+		}
+	}
+	else
+	{
+		renderer->render(frame, threads, samples);
+	}
+	const auto written = frame->write(output);
+	if (!written)
+	{
+		fprintf(stderr, "Error: could not write %s\n", output);
+	}
+
+	delete frame;
+	delete renderer;
+	delete world;
+	return written ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+// renders like render_headless, but with the tiles traced by workers that connect to port
+int render_coordinated(const char* scene_path, const char* output, const int port, const int workers, const int width, const int height,
+	const int samples, const trace_limits& limits)
+{
+	const auto world = open_scene(scene_path);
+	if (world == nullptr)
+	{
+		return EXIT_FAILURE;
+	}
+	const auto frame = new image(width, height);
+	auto written = render_distributed(world, frame, port, workers, samples, limits);
+	if (written)
+	{
+		written = frame->write(output);
+		if (!written)
+		{
+			fprintf(stderr, "Error: could not write %s\n", output);
+		}
+	}
+
+	delete frame;
+	delete world;
+	return written ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+// reads a scene in either form and writes it in the binary one
+int compile_scene(const char* input, const char* output)
+{
+	const auto world = load_scene(input);
+	if (world == nullptr)
+	{
+		return EXIT_FAILURE;
+	}
+	const auto written = write_scene_binary(world, output);
+	delete world;
+	return written ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+// RayTheTracer [--headless [output.ppm] | --benchmark [output.json] | --compile input.scene output.rtscene
+//              | --coordinator port workers [output.ppm] | --worker host port] [--scene path]
+//              [--size width height] [--samples count] [--adaptive threshold] [--wavefront] [--threads count]
+//              [--depth bounces] [--progressive] [--animate] [--denoise] [--features prefix] [--profile [trace.json]]
+// --profile needs a build with RTT_PROFILE defined; it prints where the time went at exit and writes a Chrome trace when
+// given a path. --animate moves a shape every frame of the preview, so the traced view refits its hierarchies every frame
+int main(const int argc, char** argv)
+{
+	auto headless = false;
+	auto benchmark = false;
+	const char* output = nullptr;
+	const char* scene_path = nullptr;
+	const char* compile_input = nullptr;
+	auto width = int(scr_width);
+	auto height = int(scr_height);
+	auto samples = 1;
+	auto threads = 0u;
+	auto limits = trace_limits();
+	auto threshold = 0.0f;
+	auto wavefront = false;
+	auto progressive = false;
+	auto animate = false;
+	auto denoise = false;
+	const char* features_prefix = nullptr;
+	auto profile = false;
+	const char* trace_path = nullptr;
+	auto coordinator_port = 0;
+	auto worker_count = 0;
+	const char* coordinator_host = nullptr;
+	for (auto i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "--headless") == 0)
+		{
+			headless = true;
+			if (i + 1 < argc && argv[i + 1][0] != '-')
+			{
+				output = argv[++i];
+			}
+		}
+		else if (strcmp(argv[i], "--benchmark") == 0)
+		{
+			benchmark = true;
+			if (i + 1 < argc && argv[i + 1][0] != '-')
+			{
+				output = argv[++i];
+			}
+		}
+		else if (strcmp(argv[i], "--coordinator") == 0 && i + 2 < argc)
+		{
+			coordinator_port = atoi(argv[++i]);
+			worker_count = atoi(argv[++i]);
+			if (i + 1 < argc && argv[i + 1][0] != '-')
+			{
+				output = argv[++i];
+			}
+		}
+		else if (strcmp(argv[i], "--worker") == 0 && i + 2 < argc)
+		{
+			coordinator_host = argv[++i];
+			coordinator_port = atoi(argv[++i]);
+		}
+		else if (strcmp(argv[i], "--scene") == 0 && i + 1 < argc)
+		{
+			scene_path = argv[++i];
+		}
+		else if (strcmp(argv[i], "--compile") == 0 && i + 2 < argc)
+		{
+			compile_input = argv[++i];
+			output = argv[++i];
+		}
+		else if (strcmp(argv[i], "--size") == 0 && i + 2 < argc)
+		{
+			width = atoi(argv[++i]);
+			height = atoi(argv[++i]);
+		}
+		else if (strcmp(argv[i], "--samples") == 0 && i + 1 < argc)
+		{
+			samples = atoi(argv[++i]);
+		}
+		else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc)
+		{
+			threads = unsigned(atoi(argv[++i]));
+		}
+		else if (strcmp(argv[i], "--adaptive") == 0 && i + 1 < argc)
+		{
+			threshold = float(atof(argv[++i]));
+		}
+		else if (strcmp(argv[i], "--wavefront") == 0)
+		{
+			wavefront = true;
+		}
+		else if (strcmp(argv[i], "--progressive") == 0)
+		{
+			progressive = true;
+		}
+		else if (strcmp(argv[i], "--animate") == 0)
+		{
+			animate = true;
+		}
+		else if (strcmp(argv[i], "--denoise") == 0)
+		{
+			denoise = true;
+		}
+		else if (strcmp(argv[i], "--features") == 0 && i + 1 < argc)
+		{
+			features_prefix = argv[++i];
+		}
+		else if (strcmp(argv[i], "--profile") == 0)
+		{
+			profile = true;
+			if (i + 1 < argc && argv[i + 1][0] != '-')
+			{
+				trace_path = argv[++i];
+			}
+		}
+		else if (strcmp(argv[i], "--depth") == 0 && i + 1 < argc)
+		{
+			limits.max_depth = atoi(argv[++i]);
+		}
+		else
+		{
+			fprintf(stderr, "Error: unknown argument %s\n", argv[i]);
+			return EXIT_FAILURE;
+		}
+	}
+	if (width <= 0 || height <= 0 || samples <= 0 || limits.max_depth < 0)
+	{
+		fprintf(stderr, "Error: %s\n", "size and samples must be positive, depth must not be negative");
+		return EXIT_FAILURE;
+	}
+	if (profile && !start_profiling(trace_path))
+	{
+		return EXIT_FAILURE;
+	}
+	if ((coordinator_host != nullptr || worker_count != 0) && (coordinator_port <= 0 || coordinator_port > 65535 || (coordinator_host == nullptr && worker_count <= 0)))
+	{
+		fprintf(stderr, "Error: %s\n", "the port must be in 1 to 65535 and there must be at least one worker");
+		return EXIT_FAILURE;
+	}
+	if (coordinator_host != nullptr)
+	{
+		return run_worker(coordinator_host, coordinator_port, threads);
+	}
+	if (worker_count > 0)
+	{
+		return render_coordinated(scene_path, output == nullptr ? "./render.ppm" : output, coordinator_port, worker_count, width, height, samples, limits);
+	}
+	if ((denoise || features_prefix != nullptr) && (threshold > 0.0f || wavefront))
+	{
+		fprintf(stderr, "Error: %s\n", "denoising and features need the plain renderer, not --adaptive or --wavefront");
+		return EXIT_FAILURE;
+	}
+	if (compile_input != nullptr)
+	{
+		return compile_scene(compile_input, output);
+	}
+	if (benchmark)
+	{
+		return run_benchmarks(output, scene_path, width, height, threads);
+	}
+	if (headless)
+	{
+		return render_headless(scene_path, output == nullptr ? "./render.ppm" : output, width, height, samples, threads, limits, threshold, wavefront, denoise, features_prefix);
+	}
+
+	const auto world = open_scene(scene_path);
+	if (world == nullptr)
+	{
+		return EXIT_FAILURE;
+	}
+
+	auto const window = init();
+	// glad: load all OpenGL function pointers
+	// ---------------------------------------
+	if (!gladLoadGLLoader(GLADloadproc(glfwGetProcAddress)))
+	{
+		fprintf(stderr, "Error: %s\n", "Failed to initialize GLAD");
+		return -1;
+	}
+
+	// const auto shader_program = setup_shaders();
+	const auto general_shader = new shaders("./shaders/vertex_shader.vsh", "./shaders/fragment_shader.fsh");
+	const auto lighting_shader = new shaders("./shaders/lighting_shader.vsh", "./shaders/lighting_shader.fsh");
+	const auto axis_shader = new shaders("./shaders/axis_shader.vsh", "./shaders/axis_shader.fsh");
+	const auto image_shader = new shaders("./shaders/image_shader.vsh", "./shaders/image_shader.fsh");
+	general_shader->bind_block("frame", frame_binding);
+	lighting_shader->bind_block("frame", frame_binding);
+	axis_shader->bind_block("frame", frame_binding);
+	const auto cam = world->cam;
+	const auto lamp = world->lamp;
+	// only the built in scene's cuboid is moved, the preview shows it beside where the tracer sees it
+	if (scene_path == nullptr)
+	{
+		world->shapes[1]->translate(vec3(1.4f, 0.0f, 0.0f));
+	}
+	// the built in scene's cuboid, or the last shape of a scene file
+	const auto animated = !animate || world->shapes.empty() ? nullptr : world->shapes[scene_path == nullptr ? 1 : world->shapes.size() - 1];
+	auto swung = 0.0f;
+	const auto axes = new gpu_mesh();
+	const auto queue = new render_queue();
+	const auto frame = new frame_uniforms();
+	// the ray traced view; the tracer is only built the first time it is shown
+	auto state = preview_state{ cam, lamp, progressive };
+	glfwSetWindowUserPointer(window, &state);
+	tracer* renderer = nullptr;
+	const auto accumulated = new accumulator(int(scr_width), int(scr_height), progressive_samples);
+	const auto view = new image_view();
+	char title[64];
+	//cam->rotate(-20.0f, vec3(1.0f, 0.0f, 0.0f));
+	//cam->rotate(30.0f, vec3(0.0f, 0.0f, 1.0f));
+
+	glEnable(GL_DEPTH_TEST);
+
+	axis_shader->use();
+	axis_shader->feed_mat("model", mat4(1.0f));
+
+	while (!glfwWindowShouldClose(window))
+	{
+		// translations add up, so the shape is moved by how much its swing changed since the last frame
+		if (animated != nullptr)
+		{
+			const auto swing = animation_swing * float(sin(glfwGetTime() * 2.0 * glm::pi<double>() / animation_period));
+			animated->translate(vec3(swing - swung, 0.0f, 0.0f));
+			swung = swing;
+		}
+
+		// render
+		glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+		if (state.traced)
+		{
+			if (renderer == nullptr)
+			{
+				renderer = open_tracer(world, limits);
+			}
+			if (accumulated->refine(world, renderer, threads))
+			{
+				PROFILE_SCOPE("upload image");
+				view->upload(accumulated->get_image());
+				snprintf(title, sizeof(title), "Ray the tracer - %d samples", accumulated->get_samples());
+				glfwSetWindowTitle(window, title);
+			}
+			{
+				PROFILE_SCOPE("draw image");
+				view->draw(image_shader);
+				glfwSwapBuffers(window);
+			}
+			// nothing will change on screen until something moves
+			if (accumulated->is_converged())
+			{
+				glfwWaitEvents();
+			}
+			else
+			{
+				glfwPollEvents();
+			}
+			continue;
+		}
+
+		 //cam->rotate(-0.06f, vec3(0.0f, 0.0f, 1.0f));
+		const auto proj_mat = perspective(radians(cam->get_angle()), float(scr_width) / float(scr_height), 0.1f, 100.0f);
+		const auto props = lamp->get_properties();
+		frame->update({ cam->get_view_matrix(), proj_mat, vec4(cam->get_position(), 1.0f), vec4(lamp->get_location(), 1.0f),
+			vec4(props->ambient_color, 0.0f), vec4(props->diffusion_color, 0.0f), vec4(props->specular_color, 0.0f) });
+
+		{
+			PROFILE_SCOPE("draw shapes");
+			queue->set_view(cam, int(scr_height));
+			for (auto item : world->shapes)
+			{
+				item->draw(queue, general_shader);
+			}
+			//world->projection_plane->draw(queue, general_shader);
+			lamp->draw(queue, lighting_shader);
+			queue->flush();
+
+			axis_shader->use();
+			draw_coordinate_system(axes);
+		}
+		{
+			// the driver may hold the swap until earlier frames are done, so this is where a slow GPU shows up
+			PROFILE_SCOPE("swap buffers");
+			glfwSwapBuffers(window);
+		}
+		glfwPollEvents();
+	}
+
+	// GL objects have to go before the context does
+	delete view;
+	delete accumulated;
+	delete renderer;
+	delete frame;
+	delete queue;
+	delete axes;
+	delete world;
+	delete general_shader;
+	delete lighting_shader;
+	delete axis_shader;
+	delete image_shader;
+
+	glfwDestroyWindow(window);
+	glfwTerminate();
+	exit(EXIT_SUCCESS);
+}
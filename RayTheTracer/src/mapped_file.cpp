@@ -0,0 +1,134 @@
+// Read only memory mapping of a whole file. Pages are only read in when something touches them, so opening a large
+// file costs the same as opening a small one and nothing is copied into the process.
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <cstddef>
+#include <cstdio>
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+class mapped_file
+{
+	const unsigned char* data_;
+	size_t size_;
+#if defined(_WIN32)
+	HANDLE file_;
+	HANDLE mapping_;
+#endif
+
+public:
+	mapped_file() : data_(nullptr), size_(0)
+#if defined(_WIN32)
+		, file_(INVALID_HANDLE_VALUE), mapping_(nullptr)
+#endif
+	{}
+
+	mapped_file(const mapped_file&) = delete;
+	mapped_file& operator=(const mapped_file&) = delete;
+
+	// false when the file cannot be opened or is empty
+	bool open(const char* path)
+	{
+		this->close();
+#if defined(_WIN32)
+		this->file_ = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+		if (this->file_ == INVALID_HANDLE_VALUE)
+		{
+			return false;
+		}
+		LARGE_INTEGER size;
+		if (!GetFileSizeEx(this->file_, &size) || size.QuadPart == 0)
+		{
+			this->close();
+			return false;
+		}
+		this->mapping_ = CreateFileMappingA(this->file_, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		if (this->mapping_ == nullptr)
+		{
+			this->close();
+			return false;
+		}
+		this->data_ = static_cast<const unsigned char*>(MapViewOfFile(this->mapping_, FILE_MAP_READ, 0, 0, 0));
+		if (this->data_ == nullptr)
+		{
+			this->close();
+			return false;
+		}
+		this->size_ = size_t(size.QuadPart);
+#else
+		const auto descriptor = ::open(path, O_RDONLY);
+		if (descriptor < 0)
+		{
+			return false;
+		}
+		struct stat status;
+		if (fstat(descriptor, &status) != 0 || status.st_size == 0)
+		{
+			::close(descriptor);
+			return false;
+		}
+		const auto address = mmap(nullptr, size_t(status.st_size), PROT_READ, MAP_PRIVATE, descriptor, 0);
+		// the mapping keeps the file alive on its own
+		::close(descriptor);
+		if (address == MAP_FAILED)
+		{
+			return false;
+		}
+		this->data_ = static_cast<const unsigned char*>(address);
+		this->size_ = size_t(status.st_size);
+#endif
+		return true;
+	}
+
+	void close()
+	{
+#if defined(_WIN32)
+		if (this->data_ != nullptr)
+		{
+			UnmapViewOfFile(this->data_);
+		}
+		if (this->mapping_ != nullptr)
+		{
+			CloseHandle(this->mapping_);
+		}
+		if (this->file_ != INVALID_HANDLE_VALUE)
+		{
+			CloseHandle(this->file_);
+		}
+		this->mapping_ = nullptr;
+		this->file_ = INVALID_HANDLE_VALUE;
+#else
+		if (this->data_ != nullptr)
+		{
+			munmap(const_cast<unsigned char*>(this->data_), this->size_);
+		}
+#endif
+		this->data_ = nullptr;
+		this->size_ = 0;
+	}
+
+	const unsigned char* data() const
+	{
+		return this->data_;
+	}
+
+	size_t size() const
+	{
+		return this->size_;
+	}
+
+	~mapped_file()
+	{
+		this->close();
+	}
+};
+#endif
@@ -0,0 +1,312 @@
+// Indexed triangle meshes in local space, shared between every shape of the same type and tessellation density.
+// Each distinct vertex is stored once with no per vertex color; the shape's material supplies that.
+#ifndef MESH_H
+#define MESH_H
+
+#include <glm/glm.hpp>
+#include <glm/ext.hpp>
+#include <../src/gpu_mesh.cpp>
+#include <../src/bvh.cpp>
+#include <../src/structs.cpp>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+using namespace glm;
+
+class mesh
+{
+	// geometry built in memory lives in the vectors, the views below point either at them or into a mapped scene file
+	std::vector<vec3> position_storage_;
+	std::vector<vec3> normal_storage_;
+	std::vector<unsigned> index_storage_;
+	std::shared_ptr<const void> backing_;
+	array_view<vec3> positions_;
+	// empty for meshes centred on the origin with unit radius, where the position is the normal
+	array_view<vec3> normals_;
+	array_view<unsigned> indices_;
+	// optional hierarchy built ahead of time, in the layout mesh_bvh would build itself
+	array_view<bvh_node> nodes_;
+	array_view<int> order_;
+	mutable gpu_mesh gpu_;
+
+	void refresh_views()
+	{
+		this->positions_ = array_view<vec3>(this->position_storage_.data(), this->position_storage_.size());
+		this->normals_ = array_view<vec3>(this->normal_storage_.data(), this->normal_storage_.size());
+		this->indices_ = array_view<unsigned>(this->index_storage_.data(), this->index_storage_.size());
+	}
+
+public:
+	mesh() {}
+
+	// takes the buffers over; without normals every vertex gets the area weighted average of its faces' normals
+	mesh(std::vector<vec3>&& positions, std::vector<vec3>&& normals, std::vector<unsigned>&& indices) :
+		position_storage_(std::move(positions)),
+		normal_storage_(std::move(normals)),
+		index_storage_(std::move(indices))
+	{
+		if (this->normal_storage_.empty())
+		{
+			this->generate_normals();
+		}
+		this->refresh_views();
+	}
+
+	// geometry owned by backing, typically a memory mapped file, which the mesh keeps alive
+	mesh(const std::shared_ptr<const void>& backing, const array_view<vec3> positions, const array_view<vec3> normals, const array_view<unsigned> indices) :
+		backing_(backing),
+		positions_(positions),
+		normals_(normals),
+		indices_(indices)
+	{}
+
+	mesh(const mesh&) = delete;
+	mesh& operator=(const mesh&) = delete;
+
+	unsigned add_vertex(const vec3 position)
+	{
+		this->position_storage_.push_back(position);
+		this->refresh_views();
+		return unsigned(this->position_storage_.size() - 1);
+	}
+
+	unsigned add_vertex(const vec3 position, const vec3 normal)
+	{
+		this->normal_storage_.push_back(normal);
+		return this->add_vertex(position);
+	}
+
+	// degenerate triangles, e.g. the slivers at a sphere's poles, are dropped
+	void add_triangle(const unsigned a, const unsigned b, const unsigned c)
+	{
+		if (a == b || b == c || a == c)
+		{
+			return;
+		}
+		this->index_storage_.push_back(a);
+		this->index_storage_.push_back(b);
+		this->index_storage_.push_back(c);
+		this->refresh_views();
+	}
+
+	void generate_normals()
+	{
+		this->normal_storage_.assign(this->position_storage_.size(), vec3(0.0f));
+		for (auto i = size_t(0); i + 2 < this->index_storage_.size(); i += 3)
+		{
+			const auto a = this->index_storage_[i];
+			const auto b = this->index_storage_[i + 1];
+			const auto c = this->index_storage_[i + 2];
+			// the cross product's length is twice the area, which weights the faces
+			const auto face = cross(this->position_storage_[b] - this->position_storage_[a], this->position_storage_[c] - this->position_storage_[a]);
+			this->normal_storage_[a] += face;
+			this->normal_storage_[b] += face;
+			this->normal_storage_[c] += face;
+		}
+		for (auto& normal : this->normal_storage_)
+		{
+			const auto size = length(normal);
+			normal = size > 0.0f ? normal / size : vec3(0.0f, 0.0f, 1.0f);
+		}
+		this->refresh_views();
+	}
+
+	void set_hierarchy(const array_view<bvh_node> nodes, const array_view<int> order)
+	{
+		this->nodes_ = nodes;
+		this->order_ = order;
+	}
+
+	array_view<bvh_node> get_hierarchy_nodes() const
+	{
+		return this->nodes_;
+	}
+
+	array_view<int> get_hierarchy_order() const
+	{
+		return this->order_;
+	}
+
+	array_view<vec3> get_positions() const
+	{
+		return this->positions_;
+	}
+
+	// false when positions double as normals
+	bool has_normals() const
+	{
+		return !this->normals_.empty();
+	}
+
+	array_view<vec3> get_normals() const
+	{
+		return this->normals_;
+	}
+
+	vec3 get_normal(const unsigned index) const
+	{
+		return this->normals_.empty() ? this->positions_[index] : this->normals_[index];
+	}
+
+	array_view<unsigned> get_indices() const
+	{
+		return this->indices_;
+	}
+
+	int get_number_of_triangles() const
+	{
+		return int(this->indices_.size() / 3);
+	}
+
+	// uploaded on the first bind, needs a current GL context
+	void bind() const
+	{
+		if (!this->gpu_.is_uploaded())
+		{
+			this->gpu_.upload(this->positions_, this->normals_, this->indices_);
+		}
+		this->gpu_.bind();
+	}
+
+	void draw_bound() const
+	{
+		this->gpu_.draw_bound(GL_TRIANGLES);
+	}
+};
+
+enum class mesh_type
+{
+	wall,
+	cuboid,
+	sphere
+};
+
+// unit square in the xy plane facing +z; corners are (-x -y), (+x -y), (-x +y), (+x +y)
+inline std::shared_ptr<mesh> make_wall_mesh()
+{
+	auto result = std::make_shared<mesh>();
+	const auto normal = vec3(0.0f, 0.0f, 1.0f);
+	result->add_vertex(vec3(-0.5f, -0.5f, 0.0f), normal);
+	result->add_vertex(vec3(0.5f, -0.5f, 0.0f), normal);
+	result->add_vertex(vec3(-0.5f, 0.5f, 0.0f), normal);
+	result->add_vertex(vec3(0.5f, 0.5f, 0.0f), normal);
+	result->add_triangle(0, 1, 2);
+	result->add_triangle(3, 1, 2);
+	return result;
+}
+
+// unit cube centred on the origin, four vertices per face so the edges stay sharp
+inline std::shared_ptr<mesh> make_cuboid_mesh()
+{
+	struct face
+	{
+		vec3 corners[4];
+		vec3 normal;
+	};
+	const face faces[] = {
+		// floor
+		{ { vec3(-0.5f, -0.5f, -0.5f), vec3(0.5f, -0.5f, -0.5f), vec3(0.5f, 0.5f, -0.5f), vec3(-0.5f, 0.5f, -0.5f) }, vec3(0.0f, 0.0f, -1.0f) },
+		// front wall
+		{ { vec3(-0.5f, -0.5f, -0.5f), vec3(0.5f, -0.5f, -0.5f), vec3(0.5f, -0.5f, 0.5f), vec3(-0.5f, -0.5f, 0.5f) }, vec3(0.0f, -1.0f, 0.0f) },
+		// left wall
+		{ { vec3(-0.5f, -0.5f, -0.5f), vec3(-0.5f, 0.5f, -0.5f), vec3(-0.5f, 0.5f, 0.5f), vec3(-0.5f, -0.5f, 0.5f) }, vec3(-1.0f, 0.0f, 0.0f) },
+		// right wall
+		{ { vec3(0.5f, -0.5f, -0.5f), vec3(0.5f, 0.5f, -0.5f), vec3(0.5f, 0.5f, 0.5f), vec3(0.5f, -0.5f, 0.5f) }, vec3(1.0f, 0.0f, 0.0f) },
+		// bottom wall
+		{ { vec3(-0.5f, 0.5f, -0.5f), vec3(0.5f, 0.5f, -0.5f), vec3(0.5f, 0.5f, 0.5f), vec3(-0.5f, 0.5f, 0.5f) }, vec3(0.0f, 1.0f, 0.0f) },
+		// ceiling
+		{ { vec3(-0.5f, -0.5f, 0.5f), vec3(0.5f, -0.5f, 0.5f), vec3(0.5f, 0.5f, 0.5f), vec3(-0.5f, 0.5f, 0.5f) }, vec3(0.0f, 0.0f, 1.0f) }
+	};
+	auto result = std::make_shared<mesh>();
+	for (const auto& side : faces)
+	{
+		unsigned corners[4];
+		for (auto i = 0; i < 4; i++)
+		{
+			corners[i] = result->add_vertex(side.corners[i], side.normal);
+		}
+		result->add_triangle(corners[0], corners[1], corners[2]);
+		result->add_triangle(corners[0], corners[2], corners[3]);
+	}
+	return result;
+}
+
+// unit sphere split into density bands of latitude and density slices of longitude; the seam and the poles share vertices.
+// An odd density is rounded up, with half of an odd number of bands on either side of the equator the poles stay open
+inline std::shared_ptr<mesh> make_sphere_mesh(int density)
+{
+	density += density % 2;
+	auto result = std::make_shared<mesh>();
+	const auto first_band = -(density / 2);
+	const auto last_band = density / 2;
+	auto rings = std::vector<std::vector<unsigned>>();
+	for (auto i = first_band; i <= last_band; i++)
+	{
+		const auto phi = i * (glm::pi<float>() / density);
+		auto ring = std::vector<unsigned>();
+		if (2 * i == density || 2 * i == -density)
+		{
+			ring.assign(density, result->add_vertex(vec3(0.0f, 0.0f, sin(phi))));
+		}
+		else
+		{
+			for (auto j = 0; j < density; j++)
+			{
+				const auto theta = j * 2 * glm::pi<float>() / density;
+				ring.push_back(result->add_vertex(vec3(cos(phi) * cos(theta), cos(phi) * sin(theta), sin(phi))));
+			}
+		}
+		rings.push_back(ring);
+	}
+	for (auto band = 0; band + 1 < int(rings.size()); band++)
+	{
+		const auto& lower = rings[band];
+		const auto& upper = rings[band + 1];
+		for (auto j = 0; j < density; j++)
+		{
+			const auto next = (j + 1) % density;
+			result->add_triangle(lower[j], upper[j], upper[next]);
+			result->add_triangle(lower[j], upper[next], lower[next]);
+		}
+	}
+	return result;
+}
+
+// meshes live as long as some shape holds them; density is ignored for walls and cuboids
+inline std::shared_ptr<const mesh> shared_mesh(const mesh_type type, int density = 0)
+{
+	static std::mutex lock;
+	static std::map<std::pair<int, int>, std::weak_ptr<const mesh>> cache;
+
+	if (type != mesh_type::sphere)
+	{
+		density = 0;
+	}
+	// rounded the way make_sphere_mesh does it, so two densities that build the same mesh share it
+	density += density % 2;
+	const auto key = std::make_pair(int(type), density);
+	std::lock_guard<std::mutex> guard(lock);
+	auto cached = cache[key].lock();
+	if (cached)
+	{
+		return cached;
+	}
+	switch (type)
+	{
+	case mesh_type::wall:
+		cached = make_wall_mesh();
+		break;
+	case mesh_type::cuboid:
+		cached = make_cuboid_mesh();
+		break;
+	default:
+		cached = make_sphere_mesh(density);
+		break;
+	}
+	cache[key] = cached;
+	return cached;
+}
+#endif
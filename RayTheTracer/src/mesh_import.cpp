@@ -0,0 +1,826 @@
+// Wavefront OBJ and binary PLY import straight from a mapped file. The file is cut into chunks that worker threads parse
+// in place: OBJ chunks are counted first so every chunk knows where its vertices and triangles go, then parsed again into
+// the final vectors, which the mesh takes over without a copy. Nothing is allocated per line.
+#ifndef MESH_IMPORT_H
+#define MESH_IMPORT_H
+
+#include <../src/mesh.cpp>
+#include <../src/mapped_file.cpp>
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <thread>
+#include <vector>
+
+// smallest piece of an OBJ file worth a chunk of its own
+const size_t import_chunk_bytes = size_t(1) << 20;
+
+// work(chunk) is called once for every chunk in [0, count), spread over threads
+template <typename chunk_work>
+void run_chunks(const size_t count, unsigned threads, chunk_work work)
+{
+	if (threads == 0)
+	{
+		threads = std::max(1u, std::thread::hardware_concurrency());
+	}
+	threads = unsigned(std::max(size_t(1), std::min(size_t(threads), count)));
+	std::atomic<size_t> next(0);
+	const auto worker = [&]()
+	{
+		for (auto chunk = next++; chunk < count; chunk = next++)
+		{
+			work(chunk);
+		}
+	};
+	auto workers = std::vector<std::thread>();
+	for (auto i = 1u; i < threads; i++)
+	{
+		workers.emplace_back(worker);
+	}
+	worker();
+	for (auto& thread : workers)
+	{
+		thread.join();
+	}
+}
+
+inline bool is_blank(const char c)
+{
+	return c == ' ' || c == '\t' || c == '\r';
+}
+
+inline const char* skip_blanks(const char* cursor, const char* end)
+{
+	while (cursor < end && is_blank(*cursor))
+	{
+		cursor++;
+	}
+	return cursor;
+}
+
+inline const char* skip_line(const char* cursor, const char* end)
+{
+	const auto found = static_cast<const char*>(memchr(cursor, '\n', size_t(end - cursor)));
+	return found == nullptr ? end : found + 1;
+}
+
+// decimal integer with an optional sign; null when there is none at cursor
+inline const char* parse_int(const char* cursor, const char* end, long long& value)
+{
+	auto negative = false;
+	if (cursor < end && (*cursor == '-' || *cursor == '+'))
+	{
+		negative = *cursor == '-';
+		cursor++;
+	}
+	if (cursor == end || *cursor < '0' || *cursor > '9')
+	{
+		return nullptr;
+	}
+	value = 0;
+	while (cursor < end && *cursor >= '0' && *cursor <= '9')
+	{
+		value = value * 10 + (*cursor - '0');
+		cursor++;
+	}
+	value = negative ? -value : value;
+	return cursor;
+}
+
+// decimal float with optional sign, fraction and exponent; unlike strtof it stops at end and ignores the locale
+inline const char* parse_float(const char* cursor, const char* end, float& value)
+{
+	static const double powers[] = { 1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+		1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22 };
+	auto negative = false;
+	if (cursor < end && (*cursor == '-' || *cursor == '+'))
+	{
+		negative = *cursor == '-';
+		cursor++;
+	}
+	auto mantissa = uint64_t(0);
+	auto exponent = 0;
+	auto digits = 0;
+	for (; cursor < end && *cursor >= '0' && *cursor <= '9'; cursor++, digits++)
+	{
+		// digits past what the mantissa holds only scale it
+		if (mantissa < 1000000000000000000ull)
+		{
+			mantissa = mantissa * 10 + uint64_t(*cursor - '0');
+		}
+		else
+		{
+			exponent++;
+		}
+	}
+	if (cursor < end && *cursor == '.')
+	{
+		for (cursor++; cursor < end && *cursor >= '0' && *cursor <= '9'; cursor++, digits++)
+		{
+			if (mantissa < 1000000000000000000ull)
+			{
+				mantissa = mantissa * 10 + uint64_t(*cursor - '0');
+				exponent--;
+			}
+		}
+	}
+	if (digits == 0)
+	{
+		return nullptr;
+	}
+	if (cursor < end && (*cursor == 'e' || *cursor == 'E'))
+	{
+		auto power = 0ll;
+		const auto after = parse_int(cursor + 1, end, power);
+		if (after != nullptr)
+		{
+			exponent += int(std::max(-1000ll, std::min(1000ll, power)));
+			cursor = after;
+		}
+	}
+	auto result = double(mantissa);
+	if (exponent < 0)
+	{
+		result = -exponent <= 22 ? result / powers[-exponent] : result * std::pow(10.0, exponent);
+	}
+	else if (exponent > 0)
+	{
+		result = exponent <= 22 ? result * powers[exponent] : result * std::pow(10.0, exponent);
+	}
+	value = float(negative ? -result : result);
+	return cursor;
+}
+
+// where one chunk of an OBJ file starts in the text and in the output, and what went wrong in it
+struct obj_chunk
+{
+	const char* begin;
+	const char* end;
+	size_t lines;
+	size_t positions;
+	size_t normals;
+	size_t triangles;
+	// false once a face names no normal or a different one than its vertex
+	bool normals_match;
+	const char* error;
+	size_t error_line;
+};
+
+enum class obj_line
+{
+	position,
+	normal,
+	face,
+	other
+};
+
+inline obj_line classify_obj_line(const char* cursor, const char* end)
+{
+	if (end - cursor >= 2 && cursor[0] == 'v' && is_blank(cursor[1]))
+	{
+		return obj_line::position;
+	}
+	if (end - cursor >= 3 && cursor[0] == 'v' && cursor[1] == 'n' && is_blank(cursor[2]))
+	{
+		return obj_line::normal;
+	}
+	if (end - cursor >= 2 && cursor[0] == 'f' && is_blank(cursor[1]))
+	{
+		return obj_line::face;
+	}
+	return obj_line::other;
+}
+
+// first pass: how many of each a chunk adds, so the second pass knows where its output starts
+inline void count_obj_chunk(obj_chunk& chunk)
+{
+	for (auto cursor = chunk.begin; cursor < chunk.end; chunk.lines++)
+	{
+		const auto line_end = skip_line(cursor, chunk.end);
+		cursor = skip_blanks(cursor, line_end);
+		switch (classify_obj_line(cursor, line_end))
+		{
+		case obj_line::position:
+			chunk.positions++;
+			break;
+		case obj_line::normal:
+			chunk.normals++;
+			break;
+		case obj_line::face:
+		{
+			// a polygon of n corners is fanned into n - 2 triangles; a trailing comment is not part of it, and parse_obj_chunk
+			// has to stop at the same place
+			auto corners = size_t(0);
+			for (auto item = skip_blanks(cursor + 1, line_end); item < line_end && *item != '\n' && *item != '#'; item = skip_blanks(item, line_end))
+			{
+				corners++;
+				while (item < line_end && !is_blank(*item) && *item != '\n' && *item != '#')
+				{
+					item++;
+				}
+			}
+			chunk.triangles += corners >= 3 ? corners - 2 : 0;
+			break;
+		}
+		default:
+			break;
+		}
+		cursor = line_end;
+	}
+}
+
+// resolves a 1 based or negative (relative to the ones read so far) OBJ index to a 0 based one; -1 when out of range
+inline long long resolve_obj_index(const long long index, const size_t before, const size_t total)
+{
+	const auto resolved = index > 0 ? index - 1 : static_cast<long long>(before) + index;
+	return resolved >= 0 && resolved < static_cast<long long>(total) ? resolved : -1;
+}
+
+// second pass: parses the chunk into its slice of the output, starting at the offsets the first pass added up to
+inline void parse_obj_chunk(obj_chunk& chunk, const size_t first_position, const size_t first_normal, const size_t first_triangle,
+	vec3* positions, vec3* normals, unsigned* indices, const size_t total_positions, const size_t total_normals)
+{
+	auto position = first_position;
+	auto normal = first_normal;
+	auto corner = first_triangle * 3;
+	const auto fail = [&chunk](const char* message, const size_t line)
+	{
+		chunk.error = message;
+		chunk.error_line = line;
+	};
+	auto line = size_t(0);
+	for (auto cursor = chunk.begin; cursor < chunk.end; line++)
+	{
+		const auto line_end = skip_line(cursor, chunk.end);
+		cursor = skip_blanks(cursor, line_end);
+		const auto kind = classify_obj_line(cursor, line_end);
+		if (kind == obj_line::position || kind == obj_line::normal)
+		{
+			auto value = vec3();
+			cursor += kind == obj_line::position ? 1 : 2;
+			for (auto axis = 0; axis < 3; axis++)
+			{
+				cursor = parse_float(skip_blanks(cursor, line_end), line_end, value[axis]);
+				if (cursor == nullptr)
+				{
+					return fail("expected three numbers", line);
+				}
+			}
+			if (kind == obj_line::position)
+			{
+				positions[position++] = value;
+			}
+			else
+			{
+				normals[normal++] = value;
+			}
+		}
+		else if (kind == obj_line::face)
+		{
+			auto first = 0u;
+			auto previous = 0u;
+			auto corners = 0;
+			for (cursor = skip_blanks(cursor + 1, line_end); cursor < line_end && *cursor != '\n' && *cursor != '#'; cursor = skip_blanks(cursor, line_end))
+			{
+				auto index = 0ll;
+				cursor = parse_int(cursor, line_end, index);
+				const auto vertex = cursor == nullptr ? -1 : resolve_obj_index(index, position, total_positions);
+				if (vertex < 0)
+				{
+					return fail("face refers to a vertex that does not exist", line);
+				}
+				// v, v/vt, v//vn or v/vt/vn; only the normal index matters
+				auto normal_index = -1ll;
+				if (cursor < line_end && *cursor == '/')
+				{
+					cursor++;
+					if (cursor < line_end && *cursor != '/')
+					{
+						cursor = parse_int(cursor, line_end, index);
+					}
+					if (cursor != nullptr && cursor < line_end && *cursor == '/')
+					{
+						cursor = parse_int(cursor + 1, line_end, index);
+						normal_index = cursor == nullptr ? -1 : resolve_obj_index(index, normal, total_normals);
+					}
+					if (cursor == nullptr)
+					{
+						return fail("bad face corner", line);
+					}
+				}
+				chunk.normals_match = chunk.normals_match && normal_index == vertex;
+
+				if (corners >= 2)
+				{
+					indices[corner++] = first;
+					indices[corner++] = previous;
+					indices[corner++] = unsigned(vertex);
+				}
+				if (corners == 0)
+				{
+					first = unsigned(vertex);
+				}
+				previous = unsigned(vertex);
+				corners++;
+			}
+		}
+		cursor = line_end;
+	}
+}
+
+inline std::shared_ptr<const mesh> import_obj(const char* path, const mapped_file& file, const unsigned threads)
+{
+	const auto text = reinterpret_cast<const char*>(file.data());
+	const auto end = text + file.size();
+	const auto workers = threads == 0 ? std::max(1u, std::thread::hardware_concurrency()) : threads;
+	// a few chunks per thread so a slow one does not hold the rest up, each starting at a line
+	const auto count = std::max(size_t(1), std::min(size_t(workers) * 4, file.size() / import_chunk_bytes));
+	auto chunks = std::vector<obj_chunk>(count);
+	auto begin = text;
+	for (auto i = size_t(0); i < count; i++)
+	{
+		chunks[i] = obj_chunk();
+		chunks[i].begin = begin;
+		chunks[i].end = i + 1 == count ? end : std::max(begin, skip_line(text + file.size() * (i + 1) / count, end));
+		chunks[i].normals_match = true;
+		begin = chunks[i].end;
+	}
+
+	run_chunks(count, threads, [&chunks](const size_t i) { count_obj_chunk(chunks[i]); });
+	auto totals = obj_chunk();
+	auto starts = std::vector<obj_chunk>(count);
+	for (auto i = size_t(0); i < count; i++)
+	{
+		starts[i] = totals;
+		totals.lines += chunks[i].lines;
+		totals.positions += chunks[i].positions;
+		totals.normals += chunks[i].normals;
+		totals.triangles += chunks[i].triangles;
+	}
+	if (totals.positions > size_t(UINT32_MAX) || totals.triangles == 0)
+	{
+		fprintf(stderr, "Error: %s has %s\n", path, totals.triangles == 0 ? "no faces" : "too many vertices");
+		return nullptr;
+	}
+
+	auto positions = std::vector<vec3>(totals.positions);
+	auto normals = std::vector<vec3>(totals.normals);
+	auto indices = std::vector<unsigned>(totals.triangles * 3);
+	run_chunks(count, threads, [&](const size_t i)
+	{
+		parse_obj_chunk(chunks[i], starts[i].positions, starts[i].normals, starts[i].triangles,
+			positions.data(), normals.data(), indices.data(), totals.positions, totals.normals);
+	});
+	auto normals_match = totals.normals == totals.positions;
+	for (auto i = size_t(0); i < count; i++)
+	{
+		if (chunks[i].error != nullptr)
+		{
+			fprintf(stderr, "Error: %s:%zu: %s\n", path, starts[i].lines + chunks[i].error_line + 1, chunks[i].error);
+			return nullptr;
+		}
+		normals_match = normals_match && chunks[i].normals_match;
+	}
+	// the engine keeps one normal per vertex, anything else is recomputed from the faces
+	if (!normals_match)
+	{
+		normals.clear();
+	}
+	return std::make_shared<mesh>(std::move(positions), std::move(normals), std::move(indices));
+}
+
+enum class ply_type
+{
+	none,
+	int8,
+	uint8,
+	int16,
+	uint16,
+	int32,
+	uint32,
+	float32,
+	float64
+};
+
+struct ply_property
+{
+	const char* name;
+	size_t name_length;
+	ply_type type;
+	// for lists, the type of the leading count; type is then the element type
+	ply_type count_type;
+
+	bool is(const char* other) const
+	{
+		return strlen(other) == this->name_length && memcmp(this->name, other, this->name_length) == 0;
+	}
+};
+
+struct ply_element
+{
+	const char* name;
+	size_t name_length;
+	size_t count;
+	std::vector<ply_property> properties;
+
+	bool is(const char* other) const
+	{
+		return strlen(other) == this->name_length && memcmp(this->name, other, this->name_length) == 0;
+	}
+};
+
+inline size_t ply_size(const ply_type type)
+{
+	switch (type)
+	{
+	case ply_type::int8:
+	case ply_type::uint8:
+		return 1;
+	case ply_type::int16:
+	case ply_type::uint16:
+		return 2;
+	case ply_type::int32:
+	case ply_type::uint32:
+	case ply_type::float32:
+		return 4;
+	case ply_type::float64:
+		return 8;
+	default:
+		return 0;
+	}
+}
+
+// reads one value of type at data, swapping bytes when the file's order is not the machine's
+inline double ply_read(const unsigned char* data, const ply_type type, const bool swap)
+{
+	unsigned char bytes[8];
+	const auto size = ply_size(type);
+	for (auto i = size_t(0); i < size; i++)
+	{
+		bytes[i] = data[swap ? size - 1 - i : i];
+	}
+	switch (type)
+	{
+	case ply_type::int8: { int8_t value; memcpy(&value, bytes, 1); return value; }
+	case ply_type::uint8: { uint8_t value; memcpy(&value, bytes, 1); return value; }
+	case ply_type::int16: { int16_t value; memcpy(&value, bytes, 2); return value; }
+	case ply_type::uint16: { uint16_t value; memcpy(&value, bytes, 2); return value; }
+	case ply_type::int32: { int32_t value; memcpy(&value, bytes, 4); return value; }
+	case ply_type::uint32: { uint32_t value; memcpy(&value, bytes, 4); return value; }
+	case ply_type::float32: { float value; memcpy(&value, bytes, 4); return value; }
+	case ply_type::float64: { double value; memcpy(&value, bytes, 8); return value; }
+	default: return 0.0;
+	}
+}
+
+// next word of the header line, empty at the end of it
+inline const char* ply_word(const char*& cursor, const char* end, size_t& length)
+{
+	cursor = skip_blanks(cursor, end);
+	const auto word = cursor;
+	while (cursor < end && !is_blank(*cursor) && *cursor != '\n')
+	{
+		cursor++;
+	}
+	length = size_t(cursor - word);
+	return word;
+}
+
+inline bool word_is(const char* word, const size_t length, const char* other)
+{
+	return strlen(other) == length && memcmp(word, other, length) == 0;
+}
+
+inline ply_type ply_parse_type(const char* word, const size_t length)
+{
+	const struct { const char* name; ply_type type; } names[] = {
+		{ "char", ply_type::int8 }, { "int8", ply_type::int8 }, { "uchar", ply_type::uint8 }, { "uint8", ply_type::uint8 },
+		{ "short", ply_type::int16 }, { "int16", ply_type::int16 }, { "ushort", ply_type::uint16 }, { "uint16", ply_type::uint16 },
+		{ "int", ply_type::int32 }, { "int32", ply_type::int32 }, { "uint", ply_type::uint32 }, { "uint32", ply_type::uint32 },
+		{ "float", ply_type::float32 }, { "float32", ply_type::float32 }, { "double", ply_type::float64 }, { "float64", ply_type::float64 }
+	};
+	for (const auto& entry : names)
+	{
+		if (word_is(word, length, entry.name))
+		{
+			return entry.type;
+		}
+	}
+	return ply_type::none;
+}
+
+// bytes taken by the item at data, 0 when it would run past end
+inline size_t ply_item_size(const ply_element& element, const unsigned char* data, const unsigned char* end, const bool swap)
+{
+	auto size = size_t(0);
+	for (const auto& property : element.properties)
+	{
+		if (property.count_type == ply_type::none)
+		{
+			size += ply_size(property.type);
+			continue;
+		}
+		const auto count_size = ply_size(property.count_type);
+		if (size_t(end - data) < size + count_size)
+		{
+			return 0;
+		}
+		const auto count = ply_read(data + size, property.count_type, swap);
+		size += count_size + size_t(std::max(0.0, count)) * ply_size(property.type);
+	}
+	return size_t(end - data) < size ? 0 : size;
+}
+
+// binary_little_endian or binary_big_endian with a vertex element holding x, y, z and optionally nx, ny, nz, and a face element
+// holding a list of vertex indices; other elements and properties are skipped
+inline std::shared_ptr<const mesh> import_ply(const char* path, const mapped_file& file, const unsigned threads)
+{
+	const auto text = reinterpret_cast<const char*>(file.data());
+	const auto file_end = text + file.size();
+	const auto fail = [path](const char* message) -> std::shared_ptr<const mesh>
+	{
+		fprintf(stderr, "Error: %s: %s\n", path, message);
+		return nullptr;
+	};
+
+	auto elements = std::vector<ply_element>();
+	auto swap = false;
+	auto format_known = false;
+	auto cursor = skip_line(text, file_end);
+	for (;;)
+	{
+		if (cursor == file_end)
+		{
+			return fail("header has no end_header");
+		}
+		const auto line_end = skip_line(cursor, file_end);
+		auto length = size_t(0);
+		const auto keyword = ply_word(cursor, line_end, length);
+		if (word_is(keyword, length, "end_header"))
+		{
+			cursor = line_end;
+			break;
+		}
+		if (word_is(keyword, length, "format"))
+		{
+			const auto format = ply_word(cursor, line_end, length);
+			const auto little = word_is(format, length, "binary_little_endian");
+			if (!little && !word_is(format, length, "binary_big_endian"))
+			{
+				return fail("only binary PLY files are supported");
+			}
+			const auto probe = uint16_t(1);
+			const auto machine_little = *reinterpret_cast<const unsigned char*>(&probe) == 1;
+			swap = little != machine_little;
+			format_known = true;
+		}
+		else if (word_is(keyword, length, "element"))
+		{
+			auto element = ply_element();
+			element.name = ply_word(cursor, line_end, element.name_length);
+			const auto count = ply_word(cursor, line_end, length);
+			auto value = 0ll;
+			if (parse_int(count, count + length, value) == nullptr || value < 0)
+			{
+				return fail("element without a count");
+			}
+			element.count = size_t(value);
+			elements.push_back(element);
+		}
+		else if (word_is(keyword, length, "property"))
+		{
+			if (elements.empty())
+			{
+				return fail("property outside an element");
+			}
+			auto property = ply_property();
+			property.count_type = ply_type::none;
+			auto type = ply_word(cursor, line_end, length);
+			if (word_is(type, length, "list"))
+			{
+				type = ply_word(cursor, line_end, length);
+				property.count_type = ply_parse_type(type, length);
+				type = ply_word(cursor, line_end, length);
+				if (property.count_type == ply_type::none)
+				{
+					return fail("unknown list count type");
+				}
+			}
+			property.type = ply_parse_type(type, length);
+			property.name = ply_word(cursor, line_end, property.name_length);
+			if (property.type == ply_type::none)
+			{
+				return fail("unknown property type");
+			}
+			elements.back().properties.push_back(property);
+		}
+		cursor = line_end;
+	}
+	if (!format_known)
+	{
+		return fail("header has no format");
+	}
+
+	const auto body_end = file.data() + file.size();
+	auto data = reinterpret_cast<const unsigned char*>(cursor);
+	auto positions = std::vector<vec3>();
+	auto normals = std::vector<vec3>();
+	auto indices = std::vector<unsigned>();
+	for (const auto& element : elements)
+	{
+		const auto is_vertex = element.is("vertex");
+		const auto is_face = element.is("face");
+		auto fixed = true;
+		auto stride = size_t(0);
+		for (const auto& property : element.properties)
+		{
+			fixed = fixed && property.count_type == ply_type::none;
+			stride += ply_size(property.type);
+		}
+
+		if (is_vertex)
+		{
+			if (!fixed)
+			{
+				return fail("vertex element has a list property");
+			}
+			if (size_t(body_end - data) / std::max(size_t(1), stride) < element.count || element.count > size_t(UINT32_MAX))
+			{
+				return fail("vertex data is truncated");
+			}
+			// offset and type of x, y, z, nx, ny, nz within one vertex
+			const char* names[] = { "x", "y", "z", "nx", "ny", "nz" };
+			size_t offsets[6];
+			ply_type types[6] = {};
+			auto offset = size_t(0);
+			for (const auto& property : element.properties)
+			{
+				for (auto i = 0; i < 6; i++)
+				{
+					if (property.is(names[i]))
+					{
+						offsets[i] = offset;
+						types[i] = property.type;
+					}
+				}
+				offset += ply_size(property.type);
+			}
+			if (types[0] == ply_type::none || types[1] == ply_type::none || types[2] == ply_type::none)
+			{
+				return fail("vertex element has no x, y and z");
+			}
+			const auto has_normals = types[3] != ply_type::none && types[4] != ply_type::none && types[5] != ply_type::none;
+			positions.resize(element.count);
+			normals.resize(has_normals ? element.count : 0);
+			const auto count = std::max(size_t(1), std::min(size_t(64), element.count / 65536));
+			run_chunks(count, threads, [&](const size_t chunk)
+			{
+				const auto last = element.count * (chunk + 1) / count;
+				for (auto i = element.count * chunk / count; i < last; i++)
+				{
+					const auto vertex = data + i * stride;
+					positions[i] = vec3(ply_read(vertex + offsets[0], types[0], swap), ply_read(vertex + offsets[1], types[1], swap),
+						ply_read(vertex + offsets[2], types[2], swap));
+					if (has_normals)
+					{
+						normals[i] = vec3(ply_read(vertex + offsets[3], types[3], swap), ply_read(vertex + offsets[4], types[4], swap),
+							ply_read(vertex + offsets[5], types[5], swap));
+					}
+				}
+			});
+			data += element.count * stride;
+			continue;
+		}
+
+		if (!is_face)
+		{
+			// an element we have no use for still has to be stepped over
+			for (auto i = size_t(0); i < element.count; i++)
+			{
+				const auto size = fixed ? (size_t(body_end - data) < stride ? 0 : stride) : ply_item_size(element, data, body_end, swap);
+				if (size == 0 && !element.properties.empty())
+				{
+					return fail("element data is truncated");
+				}
+				data += size;
+			}
+			continue;
+		}
+
+		// the list may only be preceded by fixed size properties, so it sits at the same offset in every face
+		auto list = element.properties.end();
+		auto list_offset = size_t(0);
+		for (auto property = element.properties.begin(); property != element.properties.end() && list == element.properties.end(); ++property)
+		{
+			if (property->count_type == ply_type::none)
+			{
+				list_offset += ply_size(property->type);
+			}
+			else if (property->is("vertex_indices") || property->is("vertex_index"))
+			{
+				list = property;
+			}
+			else
+			{
+				break;
+			}
+		}
+		if (list == element.properties.end())
+		{
+			return fail("face element has no vertex_indices list");
+		}
+
+		// faces differ in size, so one quick pass finds where every chunk starts in the file and in the index buffer
+		const auto count = std::max(size_t(1), std::min(size_t(64), element.count / 65536));
+		auto chunk_data = std::vector<const unsigned char*>(count + 1);
+		auto chunk_triangles = std::vector<size_t>(count + 1);
+		auto triangles = size_t(0);
+		auto next_chunk = size_t(0);
+		chunk_data[0] = data;
+		for (auto i = size_t(0); i < element.count; i++)
+		{
+			for (; next_chunk < count && element.count * next_chunk / count == i; next_chunk++)
+			{
+				chunk_data[next_chunk] = data;
+				chunk_triangles[next_chunk] = triangles;
+			}
+			const auto size = ply_item_size(element, data, body_end, swap);
+			if (size == 0)
+			{
+				return fail("face data is truncated");
+			}
+			const auto corners = size_t(std::max(0.0, ply_read(data + list_offset, list->count_type, swap)));
+			triangles += corners >= 3 ? corners - 2 : 0;
+			data += size;
+		}
+		chunk_data[count] = data;
+		chunk_triangles[count] = triangles;
+		if (triangles == 0)
+		{
+			return fail("no faces");
+		}
+
+		indices.resize(triangles * 3);
+		std::atomic<bool> bad_index(false);
+		const auto vertex_count = positions.size();
+		run_chunks(count, threads, [&](const size_t chunk)
+		{
+			auto corner = chunk_triangles[chunk] * 3;
+			const auto count_size = ply_size(list->count_type);
+			const auto index_size = ply_size(list->type);
+			for (auto face = chunk_data[chunk]; face < chunk_data[chunk + 1]; face += ply_item_size(element, face, body_end, swap))
+			{
+				const auto corners = size_t(std::max(0.0, ply_read(face + list_offset, list->count_type, swap)));
+				const auto items = face + list_offset + count_size;
+				auto first = 0u;
+				auto previous = 0u;
+				for (auto i = size_t(0); i < corners; i++)
+				{
+					const auto index = ply_read(items + i * index_size, list->type, swap);
+					if (index < 0.0 || index >= double(vertex_count))
+					{
+						bad_index = true;
+						return;
+					}
+					const auto vertex = unsigned(index);
+					if (i >= 2)
+					{
+						indices[corner++] = first;
+						indices[corner++] = previous;
+						indices[corner++] = vertex;
+					}
+					first = i == 0 ? vertex : first;
+					previous = vertex;
+				}
+			}
+		});
+		if (bad_index)
+		{
+			return fail("face refers to a vertex that does not exist");
+		}
+	}
+
+	if (positions.empty() || indices.empty())
+	{
+		return fail("needs a vertex and a face element, in that order");
+	}
+	return std::make_shared<mesh>(std::move(positions), std::move(normals), std::move(indices));
+}
+
+// reads an OBJ or binary PLY file, told apart by the PLY magic, with threads workers (0 for one per core); null on failure
+inline std::shared_ptr<const mesh> import_mesh(const char* path, const unsigned threads = 0)
+{
+	mapped_file file;
+	if (!file.open(path))
+	{
+		fprintf(stderr, "Error: could not map %s\n", path);
+		return nullptr;
+	}
+	const auto is_ply = file.size() >= 4 && memcmp(file.data(), "ply", 3) == 0 && (file.data()[3] == '\n' || file.data()[3] == '\r');
+	return is_ply ? import_ply(path, file, threads) : import_obj(path, file, threads);
+}
+#endif
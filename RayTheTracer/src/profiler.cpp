@@ -0,0 +1,311 @@
+// Instrumentation for finding where a run spends its time without attaching a profiler. Built with RTT_PROFILE defined, every
+// thread keeps its own counters and a list of timed scopes, and at exit a summary table goes to stderr and, when a path was
+// given to start_profiling(), the scopes go to a Chrome trace (chrome://tracing or ui.perfetto.dev). Without RTT_PROFILE
+// PROFILE_SCOPE and PROFILE_COUNT compile to nothing, so the hot paths can keep them.
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <cstdio>
+#if defined(RTT_PROFILE)
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#endif
+
+enum class profile_counter
+{
+	// closest hit queries, one per ray of a packet
+	rays,
+	shadow_rays,
+	// boxes tested, a packet against a box counts once
+	bvh_nodes,
+	// a ray or packet against one triangle
+	triangle_tests,
+	sphere_tests,
+	// camera samples taken
+	samples,
+	count
+};
+
+inline const char* profile_counter_name(const profile_counter which)
+{
+	switch (which)
+	{
+	case profile_counter::rays:
+		return "rays";
+	case profile_counter::shadow_rays:
+		return "shadow rays";
+	case profile_counter::bvh_nodes:
+		return "bvh nodes";
+	case profile_counter::triangle_tests:
+		return "triangle tests";
+	case profile_counter::sphere_tests:
+		return "sphere tests";
+	case profile_counter::samples:
+		return "samples";
+	default:
+		return "";
+	}
+}
+
+#if defined(RTT_PROFILE)
+
+// a thread stops recording scopes past this many, its counters keep going
+const size_t profile_event_limit = size_t(1) << 20;
+
+struct profile_event
+{
+	// a string literal, scopes are told apart by their text
+	const char* name;
+	// nanoseconds since the profiler started
+	long long start;
+	long long duration;
+};
+
+struct profile_thread
+{
+	// the trace's tid
+	int id;
+	unsigned long long counters[int(profile_counter::count)];
+	std::vector<profile_event> events;
+	size_t dropped;
+};
+
+class profiler
+{
+	std::mutex lock_;
+	std::vector<std::unique_ptr<profile_thread>> threads_;
+	// records of threads that have exited
+	std::vector<profile_thread*> idle_;
+	std::chrono::steady_clock::time_point start_;
+	std::string trace_path_;
+
+	profiler() : start_(std::chrono::steady_clock::now()) {}
+
+	struct scope_total
+	{
+		size_t calls;
+		long long total;
+		long long longest;
+	};
+
+	void write_trace(const char* path)
+	{
+		std::ofstream out(path);
+		out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+		auto first = true;
+		auto last = 0ll;
+		for (const auto& thread : this->threads_)
+		{
+			out << (first ? "" : ",\n") << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << thread->id
+				<< ",\"args\":{\"name\":\"thread " << thread->id << "\"}}";
+			first = false;
+			for (const auto& event : thread->events)
+			{
+				out << ",\n{\"name\":\"" << event.name << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << thread->id
+					<< ",\"ts\":" << event.start / 1000.0 << ",\"dur\":" << event.duration / 1000.0 << "}";
+				last = std::max(last, event.start + event.duration);
+			}
+		}
+		// counters are only known as totals, so each thread's show as one step at the end of the trace
+		for (const auto& thread : this->threads_)
+		{
+			out << ",\n{\"name\":\"thread " << thread->id << " counters\",\"ph\":\"C\",\"pid\":1,\"tid\":" << thread->id << ",\"ts\":" << last / 1000.0 << ",\"args\":{";
+			for (auto i = 0; i < int(profile_counter::count); i++)
+			{
+				out << (i == 0 ? "" : ",") << "\"" << profile_counter_name(profile_counter(i)) << "\":" << thread->counters[i];
+			}
+			out << "}}";
+		}
+		out << "\n]}\n";
+		if (!out)
+		{
+			fprintf(stderr, "Error: could not write the trace to %s\n", path);
+		}
+	}
+
+	void write_summary(FILE* out)
+	{
+		auto scopes = std::map<std::string, scope_total>();
+		auto dropped = size_t(0);
+		for (const auto& thread : this->threads_)
+		{
+			for (const auto& event : thread->events)
+			{
+				auto& total = scopes[event.name];
+				total.calls++;
+				total.total += event.duration;
+				total.longest = std::max(total.longest, event.duration);
+			}
+			dropped += thread->dropped;
+		}
+		auto order = std::vector<std::pair<std::string, scope_total>>(scopes.begin(), scopes.end());
+		std::sort(order.begin(), order.end(), [](const std::pair<std::string, scope_total>& left, const std::pair<std::string, scope_total>& right)
+		{
+			return left.second.total > right.second.total;
+		});
+		fprintf(out, "%-24s %10s %12s %12s %12s\n", "scope", "calls", "total ms", "mean ms", "max ms");
+		for (const auto& entry : order)
+		{
+			const auto& total = entry.second;
+			fprintf(out, "%-24s %10zu %12.3f %12.4f %12.4f\n", entry.first.c_str(), total.calls, total.total / 1e6,
+				total.total / 1e6 / double(total.calls), total.longest / 1e6);
+		}
+		if (dropped > 0)
+		{
+			fprintf(out, "%zu scopes past the limit of %zu per thread were not recorded\n", dropped, profile_event_limit);
+		}
+		fprintf(out, "%-24s %16s %16s\n", "counter", "total", "busiest thread");
+		for (auto i = 0; i < int(profile_counter::count); i++)
+		{
+			auto total = 0ull;
+			auto busiest = 0ull;
+			for (const auto& thread : this->threads_)
+			{
+				total += thread->counters[i];
+				busiest = std::max(busiest, thread->counters[i]);
+			}
+			fprintf(out, "%-24s %16llu %16llu\n", profile_counter_name(profile_counter(i)), total, busiest);
+		}
+	}
+
+public:
+	// never destroyed, threads may still record while statics are torn down
+	static profiler& get()
+	{
+		static const auto instance = new profiler();
+		return *instance;
+	}
+
+	profile_thread* acquire()
+	{
+		std::lock_guard<std::mutex> guard(this->lock_);
+		if (!this->idle_.empty())
+		{
+			const auto record = this->idle_.back();
+			this->idle_.pop_back();
+			return record;
+		}
+		this->threads_.emplace_back(new profile_thread());
+		const auto record = this->threads_.back().get();
+		record->id = int(this->threads_.size()) - 1;
+		std::fill_n(record->counters, int(profile_counter::count), 0ull);
+		record->dropped = 0;
+		return record;
+	}
+
+	void release(profile_thread* record)
+	{
+		std::lock_guard<std::mutex> guard(this->lock_);
+		this->idle_.push_back(record);
+	}
+
+	long long now() const
+	{
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - this->start_).count();
+	}
+
+	void set_trace_path(const char* path)
+	{
+		this->trace_path_ = path == nullptr ? "" : path;
+	}
+
+	// every other thread must have finished
+	void report()
+	{
+		std::lock_guard<std::mutex> guard(this->lock_);
+		write_summary(stderr);
+		if (!this->trace_path_.empty())
+		{
+			write_trace(this->trace_path_.c_str());
+		}
+	}
+};
+
+// a thread's record, handed back when the thread exits; the schedulers start fresh threads for every frame, and this way they
+// keep filling the same few rows of the trace
+struct profile_slot
+{
+	profile_thread* record;
+
+	profile_slot() : record(profiler::get().acquire()) {}
+
+	~profile_slot()
+	{
+		profiler::get().release(this->record);
+	}
+};
+
+inline profile_thread& profile_local()
+{
+	thread_local profile_slot slot;
+	return *slot.record;
+}
+
+inline void profile_count(const profile_counter which, const unsigned long long amount)
+{
+	profile_local().counters[int(which)] += amount;
+}
+
+class profile_scope
+{
+	profile_thread& thread_;
+	const char* name_;
+	long long start_;
+
+public:
+	explicit profile_scope(const char* name) : thread_(profile_local()), name_(name), start_(profiler::get().now()) {}
+
+	profile_scope(const profile_scope&) = delete;
+	profile_scope& operator=(const profile_scope&) = delete;
+
+	~profile_scope()
+	{
+		if (this->thread_.events.size() >= profile_event_limit)
+		{
+			this->thread_.dropped++;
+			return;
+		}
+		this->thread_.events.push_back(profile_event{ this->name_, this->start_, profiler::get().now() - this->start_ });
+	}
+};
+
+// the summary is printed at exit, and the trace written to trace_path unless it is null
+inline bool start_profiling(const char* trace_path)
+{
+	static auto registered = false;
+	profiler::get().set_trace_path(trace_path);
+	if (!registered)
+	{
+		registered = true;
+		atexit([]() { profiler::get().report(); });
+	}
+	return true;
+}
+
+#define PROFILE_JOIN(left, right) left##right
+#define PROFILE_NAME(line) PROFILE_JOIN(profile_scope_, line)
+// times the rest of the enclosing block under name, which has to be a string literal
+#define PROFILE_SCOPE(name) const profile_scope PROFILE_NAME(__LINE__)(name)
+#define PROFILE_COUNT(which, amount) profile_count(profile_counter::which, (amount))
+
+#else
+
+// nothing is recorded in this build
+inline bool start_profiling(const char* /*trace_path*/)
+{
+	fprintf(stderr, "Error: %s\n", "this build has no instrumentation, compile it with RTT_PROFILE defined");
+	return false;
+}
+
+#define PROFILE_SCOPE(name) ((void)0)
+#define PROFILE_COUNT(which, amount) ((void)sizeof(amount))
+
+#endif
+#endif
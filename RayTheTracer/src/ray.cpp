@@ -0,0 +1,225 @@
+// Rays, hit records and the primitives the CPU ray tracer intersects, all in world space
+#ifndef RAY_H
+#define RAY_H
+
+#include <glm/glm.hpp>
+#include <../src/material.cpp>
+#include <cfloat>
+
+// offset used to keep secondary rays from hitting the surface they start on
+const float ray_epsilon = 1e-4f;
+
+struct ray
+{
+	vec3 origin;
+	vec3 direction;
+	vec3 inverse_direction;
+
+	ray(const vec3 origin, const vec3 direction) :
+		origin(origin),
+		direction(direction),
+		inverse_direction(1.0f / direction.x, 1.0f / direction.y, 1.0f / direction.z)
+	{}
+
+	vec3 at(const float distance) const
+	{
+		return this->origin + distance * this->direction;
+	}
+};
+
+struct intersection
+{
+	float distance;
+	vec3 position;
+	vec3 normal;
+	const material* surface;
+
+	intersection() : distance(FLT_MAX), surface(nullptr) {}
+};
+
+struct aabb
+{
+	vec3 minimum;
+	vec3 maximum;
+
+	aabb() : minimum(FLT_MAX), maximum(-FLT_MAX) {}
+
+	void grow(const vec3 position)
+	{
+		this->minimum = min(this->minimum, position);
+		this->maximum = max(this->maximum, position);
+	}
+
+	void grow(const aabb& box)
+	{
+		this->minimum = min(this->minimum, box.minimum);
+		this->maximum = max(this->maximum, box.maximum);
+	}
+
+	vec3 centre() const
+	{
+		return 0.5f * (this->minimum + this->maximum);
+	}
+
+	// half the surface area, only ever compared against other boxes
+	float area() const
+	{
+		const auto extent = this->maximum - this->minimum;
+		return extent.x * extent.y + extent.y * extent.z + extent.z * extent.x;
+	}
+
+	// slab test, returns the entry distance or FLT_MAX on a miss
+	float intersect(const ray& r, const float closest) const
+	{
+		const auto near_planes = (this->minimum - r.origin) * r.inverse_direction;
+		const auto far_planes = (this->maximum - r.origin) * r.inverse_direction;
+		const auto entry = min(near_planes, far_planes);
+		const auto exit = max(near_planes, far_planes);
+		const auto t_entry = max(max(entry.x, entry.y), max(entry.z, 0.0f));
+		const auto t_exit = min(min(exit.x, exit.y), min(exit.z, closest));
+		return t_entry <= t_exit ? t_entry : FLT_MAX;
+	}
+};
+
+struct triangle
+{
+	vec3 a;
+	vec3 edge_ab;
+	vec3 edge_ac;
+	vec3 normal_a;
+	vec3 normal_b;
+	vec3 normal_c;
+	const material* surface;
+
+	triangle(const vec3 a, const vec3 b, const vec3 c, const vec3 normal_a, const vec3 normal_b, const vec3 normal_c, const material* surface) :
+		a(a),
+		edge_ab(b - a),
+		edge_ac(c - a),
+		normal_a(normal_a),
+		normal_b(normal_b),
+		normal_c(normal_c),
+		surface(surface)
+	{}
+
+	aabb bounds() const
+	{
+		aabb box;
+		box.grow(this->a);
+		box.grow(this->a + this->edge_ab);
+		box.grow(this->a + this->edge_ac);
+		return box;
+	}
+
+	// Moller-Trumbore, only overwrites the record when the hit is closer
+	bool intersect(const ray& r, intersection& record) const
+	{
+		const auto p = cross(r.direction, this->edge_ac);
+		const auto determinant = dot(this->edge_ab, p);
+		if (determinant > -1e-9f && determinant < 1e-9f)
+		{
+			return false;
+		}
+		const auto inverse_determinant = 1.0f / determinant;
+		const auto s = r.origin - this->a;
+		const auto u = dot(s, p) * inverse_determinant;
+		if (u < 0.0f || u > 1.0f)
+		{
+			return false;
+		}
+		const auto q = cross(s, this->edge_ab);
+		const auto v = dot(r.direction, q) * inverse_determinant;
+		if (v < 0.0f || u + v > 1.0f)
+		{
+			return false;
+		}
+		const auto distance = dot(this->edge_ac, q) * inverse_determinant;
+		if (distance < ray_epsilon || distance >= record.distance)
+		{
+			return false;
+		}
+		this->fill(r, distance, u, v, record);
+		return true;
+	}
+
+	// u and v are the barycentric weights of b and c
+	void fill(const ray& r, const float distance, const float u, const float v, intersection& record) const
+	{
+		record.distance = distance;
+		record.position = r.at(distance);
+		record.normal = normalize((1.0f - u - v) * this->normal_a + u * this->normal_b + v * this->normal_c);
+		record.surface = this->surface;
+	}
+};
+
+// analytic sphere, replaces the tessellated mesh for intersection
+struct sphere_primitive
+{
+	vec3 centre;
+	float radius;
+	const material* surface;
+
+	sphere_primitive(const vec3 centre, const float radius, const material* surface) :
+		centre(centre),
+		radius(radius),
+		surface(surface)
+	{}
+
+	aabb bounds() const
+	{
+		aabb box;
+		box.grow(this->centre - vec3(this->radius));
+		box.grow(this->centre + vec3(this->radius));
+		return box;
+	}
+
+	// ray directions are unit length, so the quadratic's leading coefficient is 1
+	bool intersect(const ray& r, intersection& record) const
+	{
+		const auto offset = r.origin - this->centre;
+		const auto b = dot(offset, r.direction);
+		const auto c = dot(offset, offset) - this->radius * this->radius;
+		const auto discriminant = b * b - c;
+		if (discriminant < 0.0f)
+		{
+			return false;
+		}
+		const auto root = sqrt(discriminant);
+		auto distance = -b - root;
+		if (distance < ray_epsilon)
+		{
+			distance = -b + root;
+		}
+		if (distance < ray_epsilon || distance >= record.distance)
+		{
+			return false;
+		}
+		this->fill(r, distance, record);
+		return true;
+	}
+
+	// whether the sphere is hit anywhere before max_distance, without working out where
+	bool occludes(const ray& r, const float max_distance) const
+	{
+		const auto offset = r.origin - this->centre;
+		const auto b = dot(offset, r.direction);
+		const auto c = dot(offset, offset) - this->radius * this->radius;
+		const auto discriminant = b * b - c;
+		if (discriminant < 0.0f)
+		{
+			return false;
+		}
+		const auto root = sqrt(discriminant);
+		const auto near_distance = -b - root;
+		const auto distance = near_distance >= ray_epsilon ? near_distance : -b + root;
+		return distance >= ray_epsilon && distance < max_distance;
+	}
+
+	void fill(const ray& r, const float distance, intersection& record) const
+	{
+		record.distance = distance;
+		record.position = r.at(distance);
+		record.normal = (record.position - this->centre) / this->radius;
+		record.surface = this->surface;
+	}
+};
+#endif
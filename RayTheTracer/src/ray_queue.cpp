@@ -0,0 +1,135 @@
+// Structure of arrays ray queues for the wavefront renderer: every component lives in its own array so a batch of rays can be
+// loaded into packets lane by lane. Clearing keeps the capacity, so a queue reused from tile to tile stops allocating once it
+// has seen its largest batch.
+#ifndef RAY_QUEUE_H
+#define RAY_QUEUE_H
+
+#include <../src/ray.cpp>
+#include <vector>
+
+// rays waiting to be intersected, with the share of their pixel they carry
+struct ray_queue
+{
+	std::vector<float> origin_x;
+	std::vector<float> origin_y;
+	std::vector<float> origin_z;
+	std::vector<float> direction_x;
+	std::vector<float> direction_y;
+	std::vector<float> direction_z;
+	std::vector<float> weight_r;
+	std::vector<float> weight_g;
+	std::vector<float> weight_b;
+	// index of the pixel within the batch
+	std::vector<int> pixel;
+	// random state of the path the ray continues
+	std::vector<unsigned> seed;
+
+	size_t size() const
+	{
+		return this->pixel.size();
+	}
+
+	void clear()
+	{
+		this->origin_x.clear();
+		this->origin_y.clear();
+		this->origin_z.clear();
+		this->direction_x.clear();
+		this->direction_y.clear();
+		this->direction_z.clear();
+		this->weight_r.clear();
+		this->weight_g.clear();
+		this->weight_b.clear();
+		this->pixel.clear();
+		this->seed.clear();
+	}
+
+	void push(const vec3 origin, const vec3 direction, const vec3 weight, const int pixel, const unsigned seed)
+	{
+		this->origin_x.push_back(origin.x);
+		this->origin_y.push_back(origin.y);
+		this->origin_z.push_back(origin.z);
+		this->direction_x.push_back(direction.x);
+		this->direction_y.push_back(direction.y);
+		this->direction_z.push_back(direction.z);
+		this->weight_r.push_back(weight.r);
+		this->weight_g.push_back(weight.g);
+		this->weight_b.push_back(weight.b);
+		this->pixel.push_back(pixel);
+		this->seed.push_back(seed);
+	}
+
+	ray get_ray(const size_t index) const
+	{
+		return ray(vec3(this->origin_x[index], this->origin_y[index], this->origin_z[index]),
+			vec3(this->direction_x[index], this->direction_y[index], this->direction_z[index]));
+	}
+
+	vec3 get_weight(const size_t index) const
+	{
+		return vec3(this->weight_r[index], this->weight_g[index], this->weight_b[index]);
+	}
+};
+
+// shadow rays waiting for an any-hit test, with what they add to their pixel when nothing blocks them
+struct shadow_queue
+{
+	std::vector<float> origin_x;
+	std::vector<float> origin_y;
+	std::vector<float> origin_z;
+	std::vector<float> direction_x;
+	std::vector<float> direction_y;
+	std::vector<float> direction_z;
+	std::vector<float> distance;
+	std::vector<float> light_r;
+	std::vector<float> light_g;
+	std::vector<float> light_b;
+	std::vector<int> pixel;
+
+	size_t size() const
+	{
+		return this->pixel.size();
+	}
+
+	void clear()
+	{
+		this->origin_x.clear();
+		this->origin_y.clear();
+		this->origin_z.clear();
+		this->direction_x.clear();
+		this->direction_y.clear();
+		this->direction_z.clear();
+		this->distance.clear();
+		this->light_r.clear();
+		this->light_g.clear();
+		this->light_b.clear();
+		this->pixel.clear();
+	}
+
+	void push(const vec3 origin, const vec3 direction, const float distance, const vec3 light, const int pixel)
+	{
+		this->origin_x.push_back(origin.x);
+		this->origin_y.push_back(origin.y);
+		this->origin_z.push_back(origin.z);
+		this->direction_x.push_back(direction.x);
+		this->direction_y.push_back(direction.y);
+		this->direction_z.push_back(direction.z);
+		this->distance.push_back(distance);
+		this->light_r.push_back(light.r);
+		this->light_g.push_back(light.g);
+		this->light_b.push_back(light.b);
+		this->pixel.push_back(pixel);
+	}
+
+	ray get_ray(const size_t index) const
+	{
+		return ray(vec3(this->origin_x[index], this->origin_y[index], this->origin_z[index]),
+			vec3(this->direction_x[index], this->direction_y[index], this->direction_z[index]));
+	}
+
+	vec3 get_light(const size_t index) const
+	{
+		return vec3(this->light_r[index], this->light_g[index], this->light_b[index]);
+	}
+};
+#endif
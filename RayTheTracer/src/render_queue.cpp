@@ -0,0 +1,172 @@
+// Raster preview submission: shapes queue draw items instead of drawing, the queue sorts them by program, material and
+// mesh and only touches GL state that differs from the previous item. Camera and light live in one uniform buffer
+// per frame that every program reads through its "frame" block. The queue also knows where the camera is, so shapes can
+// pick how detailed a mesh to submit from how big they will look.
+#ifndef RENDER_QUEUE_H
+#define RENDER_QUEUE_H
+
+#include <glm/glm.hpp>
+#include <glm/gtc/type_ptr.hpp>
+#include <../headers/shaders.hpp>
+#include <../src/camera.cpp>
+#include <../src/mesh.cpp>
+#include <../src/material.cpp>
+#include <algorithm>
+#include <cfloat>
+#include <tuple>
+#include <vector>
+
+// binding point of the frame block in every program
+const GLuint frame_binding = 0;
+
+struct draw_item
+{
+	const shaders* program;
+	const material* surface;
+	float specular;
+	const mesh* geometry;
+	mat4 model;
+	// inverse transpose of the model matrix's upper 3x3, worked out once on the CPU
+	mat3 normal_matrix;
+};
+
+// std140 layout of the frame block, vec3s padded to vec4
+struct frame_block
+{
+	mat4 view;
+	mat4 projection;
+	vec4 view_pos;
+	vec4 light_position;
+	vec4 light_ambient;
+	vec4 light_diffuse;
+	vec4 light_specular;
+};
+
+class frame_uniforms
+{
+	GLuint buffer_;
+
+public:
+	frame_uniforms() : buffer_(0) {}
+
+	frame_uniforms(const frame_uniforms&) = delete;
+	frame_uniforms& operator=(const frame_uniforms&) = delete;
+
+	// one upload per frame, shared by every program bound to frame_binding
+	void update(const frame_block& block)
+	{
+		if (this->buffer_ == 0)
+		{
+			glGenBuffers(1, &this->buffer_);
+			glBindBuffer(GL_UNIFORM_BUFFER, this->buffer_);
+			glBufferData(GL_UNIFORM_BUFFER, sizeof(frame_block), nullptr, GL_DYNAMIC_DRAW);
+			glBindBufferBase(GL_UNIFORM_BUFFER, frame_binding, this->buffer_);
+		}
+		glBindBuffer(GL_UNIFORM_BUFFER, this->buffer_);
+		glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(frame_block), &block);
+	}
+
+	~frame_uniforms()
+	{
+		if (this->buffer_ != 0)
+		{
+			glDeleteBuffers(1, &this->buffer_);
+		}
+	}
+};
+
+class render_queue
+{
+	struct program_locations
+	{
+		GLint model;
+		GLint normal_matrix;
+		GLint ambient;
+		GLint diffuse;
+		GLint specular;
+		GLint shininess;
+	};
+
+	std::vector<draw_item> items_;
+	vec3 eye_;
+	// half the viewport's height over the tangent of half the field of view: how many pixels something one unit across
+	// covers one unit in front of the camera; 0 until set_view() is called
+	float focal_pixels_;
+
+	static bool same_material(const draw_item& left, const draw_item& right)
+	{
+		// only the color and specular strength reach the shader, so materials that agree on them need no new uniforms
+		return left.surface->dye() == right.surface->dye() && left.specular == right.specular;
+	}
+
+public:
+	render_queue() : eye_(0.0f), focal_pixels_(0.0f) {}
+
+	// the camera the coming frame is seen through, with a perspective of the camera's angle over viewport_height pixels
+	void set_view(const camera* cam, const int viewport_height)
+	{
+		this->eye_ = cam->get_position();
+		this->focal_pixels_ = 0.5f * float(viewport_height) / tan(radians(cam->get_angle()) * 0.5f);
+	}
+
+	// radius in pixels of a ball's outline in the middle of the view; FLT_MAX without a view or with the camera inside it,
+	// so everything is drawn at full detail then
+	float get_screen_radius(const vec3 centre, const float radius) const
+	{
+		const auto offset = centre - this->eye_;
+		const auto distance_squared = dot(offset, offset) - radius * radius;
+		if (this->focal_pixels_ <= 0.0f || distance_squared <= 0.0f)
+		{
+			return FLT_MAX;
+		}
+		return this->focal_pixels_ * radius / sqrt(distance_squared);
+	}
+
+	void submit(const draw_item& item)
+	{
+		this->items_.push_back(item);
+	}
+
+	// draws everything queued since the last flush and empties the queue
+	void flush()
+	{
+		std::sort(this->items_.begin(), this->items_.end(), [](const draw_item& left, const draw_item& right)
+		{
+			const auto left_color = left.surface->dye();
+			const auto right_color = right.surface->dye();
+			return std::make_tuple(left.program->get_id(), left_color.r, left_color.g, left_color.b, left.specular, left.geometry)
+				< std::make_tuple(right.program->get_id(), right_color.r, right_color.g, right_color.b, right.specular, right.geometry);
+		});
+
+		const draw_item* previous = nullptr;
+		auto locations = program_locations();
+		for (const auto& item : this->items_)
+		{
+			const auto program_changed = previous == nullptr || previous->program != item.program;
+			if (program_changed)
+			{
+				item.program->use();
+				locations = { item.program->get_location("model"), item.program->get_location("normal_matrix"), item.program->get_location("material.ambient"),
+					item.program->get_location("material.diffuse"), item.program->get_location("material.specular"),
+					item.program->get_location("material.shininess") };
+			}
+			if (program_changed || !same_material(*previous, item))
+			{
+				item.program->feed_vec(locations.ambient, item.surface->dye());
+				item.program->feed_vec(locations.diffuse, item.surface->dye());
+				item.program->feed_vec(locations.specular, vec3(item.specular));
+				item.program->feed_float(locations.shininess, 128.0f);
+			}
+			if (previous == nullptr || previous->geometry != item.geometry)
+			{
+				item.geometry->bind();
+			}
+			item.program->feed_mat(locations.model, item.model);
+			item.program->feed_mat(locations.normal_matrix, item.normal_matrix);
+			item.geometry->draw_bound();
+			previous = &item;
+		}
+		this->items_.clear();
+	}
+};
+#endif
@@ -0,0 +1,135 @@
+// The scene both front ends render: camera, projection plane, lamp and shapes, built without touching OpenGL
+#ifndef SCENE_H
+#define SCENE_H
+
+#include <../src/light.cpp>
+#include <../src/camera.cpp>
+#include <../src/arena.cpp>
+#include <utility>
+#include <vector>
+
+// owns everything it holds; materials and shapes live in one arena that is freed with the scene
+class scene
+{
+	arena storage_;
+
+	void track(material* surface)
+	{
+		this->materials.push_back(surface);
+	}
+
+	void track(shape* item)
+	{
+		this->shapes.push_back(item);
+	}
+
+	void track(scene_node* group)
+	{
+		this->groups.push_back(group);
+	}
+
+public:
+	camera* cam;
+	wall* projection_plane;
+	light* lamp;
+	std::vector<material*> materials;
+	std::vector<shape*> shapes;
+	// transform only nodes that shapes and other groups hang from
+	std::vector<scene_node*> groups;
+
+	scene() : cam(nullptr), projection_plane(nullptr), lamp(nullptr) {}
+
+	scene(const scene&) = delete;
+	scene& operator=(const scene&) = delete;
+
+	// makes a material, shape or group in the scene's arena and lists it, e.g. add<sphere>(gold, 100)
+	template <typename item, typename... arguments>
+	item* add(arguments&&... values)
+	{
+		const auto made = this->storage_.make<item>(std::forward<arguments>(values)...);
+		this->track(made);
+		return made;
+	}
+
+	size_t get_memory_usage() const
+	{
+		return this->storage_.get_memory_usage();
+	}
+
+	// sum of the camera's, the lamp's and every node's version; the counters only grow, so the sum changes exactly when
+	// something in the scene moved
+	unsigned long long get_version() const
+	{
+		auto version = 0ull + this->cam->get_version() + this->lamp->get_version() + this->projection_plane->get_version();
+		for (const auto item : this->shapes)
+		{
+			version += item->get_version();
+		}
+		for (const auto group : this->groups)
+		{
+			version += group->get_version();
+		}
+		return version;
+	}
+
+	~scene()
+	{
+		delete this->projection_plane;
+		delete this->lamp;
+		delete this->cam;
+	}
+};
+
+// camera, lamp and projection plane shared by the built in scenes; materials[0] is the light grey the walls use
+inline scene* open_box()
+{
+	const auto world = new scene();
+	world->cam = new camera();
+	world->cam->scale(2.0f);
+	world->lamp = new light(vec3(1.4f, 1.4f, 1.4f));
+
+	const auto light_grey = world->add<material>(0.5f, 0.0f, 0.5f, vec3(0.8f, 0.8f, 0.8f));
+	world->projection_plane = new wall(light_grey);
+	world->projection_plane->rotate(90.0f, vec3(1.0f, 0.0f, 0.0f));
+	world->projection_plane->scale(vec3(5.3f, 5.3f, 5.3f));
+	return world;
+}
+
+// floor, far wall and left wall of the 3x3x3 box centred at (0, 1.5, 0)
+inline void add_walls(scene* world)
+{
+	const auto light_grey = world->materials[0];
+
+	const auto floor = world->add<wall>(light_grey);
+	floor->translate(vec3(0.0f, 1.5f, -1.5f));
+	floor->scale(vec3(3.0f, 3.0f, 3.0f));
+
+	const auto far_wall = world->add<wall>(light_grey);
+	far_wall->translate(vec3(0.0f, 3.0f, 0.0f));
+	far_wall->rotate(90.0f, vec3(1.0f, 0.0f, 0.0f));
+	far_wall->scale(vec3(3.0f, 3.0f, 3.0f));
+
+	const auto left_wall = world->add<wall>(light_grey);
+	left_wall->translate(vec3(-1.5f, 1.5f, 0.0f));
+	left_wall->rotate(90.0f, vec3(0.0f, 1.0f, 0.0f));
+	left_wall->scale(vec3(3.0f, 3.0f, 3.0f));
+}
+
+// gold sphere and cuboid in the box; shapes are in drawing order, the cuboid is shapes[1]
+inline scene* cornell_box()
+{
+	const auto world = open_box();
+	const auto gold = world->add<material>(0.5f, 0.0f, 0.5f, vec3(1.0f, 0.83f, 0.3f));
+
+	const auto sph = world->add<sphere>(gold, 100);
+	sph->translate(vec3(-0.8f, 2.4f, -0.9f));
+	sph->scale(vec3(0.5f, 0.5f, 0.5f));
+
+	const auto rect = world->add<cuboid>(gold);
+	rect->translate(vec3(0.1f, 2.1f, -0.5f));
+	rect->scale(vec3(0.7f, 0.7f, 0.7f));
+
+	add_walls(world);
+	return world;
+}
+#endif
@@ -0,0 +1,679 @@
+// Scene files in two forms. The text form is written by hand, one statement per line:
+//
+//   # comment
+//   camera <angle> <position x y z> <target x y z> <up x y z>
+//   light <x y z>
+//   material <name> <absorb> <refract> <reflect> <r g b>
+//   plane <material> [transforms]            projection plane
+//   wall <material> [transforms]
+//   cuboid <material> [transforms]
+//   sphere <material> <density> [transforms]
+//   mesh <name>                               followed by v x y z, vn x y z and f a b c (0 based) lines up to end
+//   mesh <name> <file>                        imported from an OBJ or binary PLY file, relative to the scene file
+//   instance <mesh> <material> [transforms]
+//   group <name> [transforms]                 a transform that shapes and other groups can hang from
+//
+// where transforms are any number of translate x y z, rotate angle x y z and scale x y z, applied in order, and
+// parent <group> to place the item relative to a group read earlier.
+//
+// The binary form is what --compile writes: fixed size records and flat arrays at 16 byte aligned offsets, in the byte order
+// of the machine that wrote it. Loading maps the file and points the meshes straight at the mapped arrays, so nothing is
+// parsed or copied and pages are only read once the renderer touches them. Each mesh carries the hierarchy the tracer
+// would otherwise build for it at startup. Groups are baked into the world matrix of every shape under them. The same bytes
+// are what a distributed render sends its workers, read straight out of the receive buffer.
+#ifndef SCENE_FILE_H
+#define SCENE_FILE_H
+
+#include <../src/scene.cpp>
+#include <../src/instances.cpp>
+#include <../src/mapped_file.cpp>
+#include <../src/mesh_import.cpp>
+#include <glm/gtc/type_ptr.hpp>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+const char scene_magic[8] = { 'R', 'T', 'S', 'C', 'E', 'N', 'E', '\0' };
+const uint32_t scene_version = 1;
+// reads back as a different number on a machine of the other byte order
+const uint32_t scene_byte_order = 0x01020304;
+
+enum class scene_shape : uint32_t
+{
+	wall,
+	cuboid,
+	sphere,
+	mesh
+};
+
+struct scene_header
+{
+	char magic[8];
+	uint32_t version;
+	uint32_t byte_order;
+	uint32_t material_count;
+	uint32_t shape_count;
+	uint32_t mesh_count;
+	uint32_t plane_material;
+	uint64_t materials;
+	uint64_t shapes;
+	uint64_t meshes;
+	float camera_angle;
+	float camera_position[3];
+	float camera_target[3];
+	float camera_up[3];
+	float light_position[3];
+	float plane_model[16];
+	uint32_t padding;
+};
+
+struct scene_material
+{
+	float absorb;
+	float refract;
+	float reflect;
+	float color[3];
+};
+
+struct scene_shape_record
+{
+	scene_shape type;
+	uint32_t material;
+	// index into the mesh table for meshes, tessellation density for spheres
+	uint32_t detail;
+	uint32_t padding;
+	float model[16];
+};
+
+// offsets are from the start of the file, a hierarchy is optional and absent when node_count is 0
+struct scene_mesh
+{
+	uint64_t positions;
+	uint64_t normals;
+	uint64_t indices;
+	uint64_t nodes;
+	uint64_t order;
+	uint32_t position_count;
+	uint32_t normal_count;
+	uint32_t index_count;
+	uint32_t node_count;
+	uint32_t order_count;
+	uint32_t padding;
+};
+
+// the mapped arrays are used as they are, so their layout must not depend on the compiler
+static_assert(sizeof(vec3) == 12, "vec3 must be three packed floats");
+static_assert(sizeof(bvh_node) == 32, "bvh_node layout changed, bump scene_version");
+static_assert(sizeof(scene_header) == 176, "scene_header layout changed, bump scene_version");
+static_assert(sizeof(scene_material) == 24, "scene_material layout changed, bump scene_version");
+static_assert(sizeof(scene_shape_record) == 80, "scene_shape_record layout changed, bump scene_version");
+static_assert(sizeof(scene_mesh) == 64, "scene_mesh layout changed, bump scene_version");
+
+inline bool read_vec3(std::istringstream& line, vec3& value)
+{
+	return bool(line >> value.x >> value.y >> value.z);
+}
+
+// applies every transform left on the line to item, permanently
+inline bool read_transforms(std::istringstream& line, scene_node* item, const std::map<std::string, scene_node*>& groups, std::string& error)
+{
+	auto name = std::string();
+	while (line >> name)
+	{
+		auto amount = vec3();
+		if (name == "parent")
+		{
+			auto group = std::string();
+			line >> group;
+			const auto entry = groups.find(group);
+			if (entry == groups.end())
+			{
+				error = "unknown group " + group;
+				return false;
+			}
+			item->set_parent(entry->second);
+		}
+		else if (name == "translate" && read_vec3(line, amount))
+		{
+			item->translate(amount);
+		}
+		else if (name == "scale" && read_vec3(line, amount))
+		{
+			item->scale(amount);
+		}
+		else if (name == "rotate")
+		{
+			auto angle = 0.0f;
+			if (!(line >> angle) || !read_vec3(line, amount) || length(amount) == 0.0f)
+			{
+				error = "rotate needs an angle and an axis";
+				return false;
+			}
+			item->rotate(angle, normalize(amount));
+		}
+		else
+		{
+			error = "bad transform " + name;
+			return false;
+		}
+	}
+	return true;
+}
+
+inline scene* load_scene_text(const char* path)
+{
+	std::ifstream file(path);
+	if (!file)
+	{
+		fprintf(stderr, "Error: could not open %s\n", path);
+		return nullptr;
+	}
+
+	auto world = std::unique_ptr<scene>(new scene());
+	auto materials = std::map<std::string, material*>();
+	auto meshes = std::map<std::string, std::shared_ptr<const mesh>>();
+	auto groups = std::map<std::string, scene_node*>();
+	const auto find_material = [&](std::istringstream& line, material*& found, std::string& error)
+	{
+		auto name = std::string();
+		line >> name;
+		const auto entry = materials.find(name);
+		if (entry == materials.end())
+		{
+			error = "unknown material " + name;
+			return false;
+		}
+		found = entry->second;
+		return true;
+	};
+
+	auto text = std::string();
+	auto number = 0;
+	auto error = std::string();
+	// the mesh being read between mesh and end
+	auto mesh_name = std::string();
+	auto positions = std::vector<vec3>();
+	auto normals = std::vector<vec3>();
+	auto indices = std::vector<unsigned>();
+	while (error.empty() && std::getline(file, text))
+	{
+		number++;
+		const auto comment = text.find('#');
+		if (comment != std::string::npos)
+		{
+			text.erase(comment);
+		}
+		auto line = std::istringstream(text);
+		auto statement = std::string();
+		if (!(line >> statement))
+		{
+			continue;
+		}
+
+		if (!mesh_name.empty())
+		{
+			auto value = vec3();
+			unsigned a, b, c;
+			if (statement == "v" && read_vec3(line, value))
+			{
+				positions.push_back(value);
+			}
+			else if (statement == "vn" && read_vec3(line, value))
+			{
+				normals.push_back(value);
+			}
+			else if (statement == "f" && line >> a >> b >> c)
+			{
+				if (a >= positions.size() || b >= positions.size() || c >= positions.size())
+				{
+					error = "face refers to a vertex that is not defined yet";
+				}
+				indices.push_back(a);
+				indices.push_back(b);
+				indices.push_back(c);
+			}
+			else if (statement == "end")
+			{
+				if (!normals.empty() && normals.size() != positions.size())
+				{
+					error = "mesh " + mesh_name + " needs one normal per vertex or none";
+				}
+				else
+				{
+					meshes[mesh_name] = std::make_shared<mesh>(std::move(positions), std::move(normals), std::move(indices));
+				}
+				positions.clear();
+				normals.clear();
+				indices.clear();
+				mesh_name.clear();
+			}
+			else
+			{
+				error = "bad mesh statement " + statement;
+			}
+			continue;
+		}
+
+		material* surface = nullptr;
+		if (statement == "camera")
+		{
+			auto angle = 0.0f;
+			vec3 position, target, up;
+			if (!(line >> angle) || !read_vec3(line, position) || !read_vec3(line, target) || !read_vec3(line, up))
+			{
+				error = "camera needs an angle, a position, a target and an up vector";
+			}
+			else
+			{
+				delete world->cam;
+				world->cam = new camera(angle, position, target, up);
+			}
+		}
+		else if (statement == "light")
+		{
+			auto position = vec3();
+			if (!read_vec3(line, position))
+			{
+				error = "light needs a position";
+			}
+			else
+			{
+				delete world->lamp;
+				world->lamp = new light(position);
+			}
+		}
+		else if (statement == "material")
+		{
+			auto name = std::string();
+			float absorb, refract, reflect;
+			auto color = vec3();
+			if (!(line >> name >> absorb >> refract >> reflect) || !read_vec3(line, color))
+			{
+				error = "material needs a name, absorption, refraction, reflection and a color";
+			}
+			else
+			{
+				materials[name] = world->add<material>(absorb, refract, reflect, color);
+			}
+		}
+		else if (statement == "plane")
+		{
+			if (find_material(line, surface, error))
+			{
+				delete world->projection_plane;
+				world->projection_plane = new wall(surface);
+				read_transforms(line, world->projection_plane, groups, error);
+			}
+		}
+		else if (statement == "wall" || statement == "cuboid")
+		{
+			if (find_material(line, surface, error))
+			{
+				if (statement == "wall")
+				{
+					read_transforms(line, world->add<wall>(surface), groups, error);
+				}
+				else
+				{
+					read_transforms(line, world->add<cuboid>(surface), groups, error);
+				}
+			}
+		}
+		else if (statement == "sphere")
+		{
+			auto density = 0;
+			if (find_material(line, surface, error))
+			{
+				if (!(line >> density) || density < 2)
+				{
+					error = "sphere needs a density of at least 2";
+				}
+				else
+				{
+					read_transforms(line, world->add<sphere>(surface, density), groups, error);
+				}
+			}
+		}
+		else if (statement == "mesh")
+		{
+			auto source = std::string();
+			if (!(line >> mesh_name))
+			{
+				error = "mesh needs a name";
+			}
+			else if (line >> source)
+			{
+				const auto separator = std::string(path).find_last_of("/\\");
+				if (separator != std::string::npos && source[0] != '/' && source[0] != '\\' && source.find(':') == std::string::npos)
+				{
+					source = std::string(path, separator + 1) + source;
+				}
+				const auto imported = import_mesh(source.c_str());
+				if (!imported)
+				{
+					error = "could not import " + source;
+				}
+				meshes[mesh_name] = imported;
+				mesh_name.clear();
+			}
+		}
+		else if (statement == "instance")
+		{
+			auto name = std::string();
+			line >> name;
+			const auto entry = meshes.find(name);
+			if (entry == meshes.end())
+			{
+				error = "unknown mesh " + name;
+			}
+			else if (find_material(line, surface, error))
+			{
+				read_transforms(line, world->add<mesh_shape>(surface, entry->second), groups, error);
+			}
+		}
+		else if (statement == "group")
+		{
+			auto name = std::string();
+			if (!(line >> name) || groups.count(name) != 0)
+			{
+				error = "group needs a name of its own";
+			}
+			else
+			{
+				const auto group = world->add<scene_node>();
+				groups[name] = group;
+				read_transforms(line, group, groups, error);
+			}
+		}
+		else
+		{
+			error = "unknown statement " + statement;
+		}
+	}
+
+	if (error.empty() && !mesh_name.empty())
+	{
+		error = "mesh " + mesh_name + " has no end";
+	}
+	if (!error.empty())
+	{
+		fprintf(stderr, "Error: %s:%d: %s\n", path, number, error.c_str());
+		return nullptr;
+	}
+	if (world->cam == nullptr || world->lamp == nullptr || world->projection_plane == nullptr)
+	{
+		fprintf(stderr, "Error: %s needs a camera, a light and a plane\n", path);
+		return nullptr;
+	}
+	return world.release();
+}
+
+// index of the material with the same properties as surface, added to table when there is none
+inline uint32_t material_index(std::vector<scene_material>& table, const material* surface)
+{
+	const auto color = surface->dye();
+	const scene_material record = { surface->absorb(), surface->refract(), surface->reflect(), { color.r, color.g, color.b } };
+	for (auto i = size_t(0); i < table.size(); i++)
+	{
+		if (memcmp(&table[i], &record, sizeof(record)) == 0)
+		{
+			return uint32_t(i);
+		}
+	}
+	table.push_back(record);
+	return uint32_t(table.size() - 1);
+}
+
+// appends size bytes at the next 16 byte boundary of blob and returns their offset; null items leaves them zeroed
+inline uint64_t append_array(std::vector<unsigned char>& blob, const void* items, const size_t size)
+{
+	blob.resize((blob.size() + 15) & ~size_t(15));
+	const auto offset = size_t(blob.size());
+	blob.resize(offset + size);
+	if (items != nullptr && size > 0)
+	{
+		memcpy(&blob[offset], items, size);
+	}
+	return offset;
+}
+
+// the binary form of world in memory: materials shared by value, every mesh with the hierarchy the tracer would build for it
+inline std::vector<unsigned char> pack_scene(const scene* world)
+{
+	auto header = scene_header();
+	memcpy(header.magic, scene_magic, sizeof(scene_magic));
+	header.version = scene_version;
+	header.byte_order = scene_byte_order;
+	header.camera_angle = world->cam->get_angle();
+	memcpy(header.camera_position, value_ptr(world->cam->get_position()), sizeof(header.camera_position));
+	memcpy(header.camera_target, value_ptr(world->cam->get_target()), sizeof(header.camera_target));
+	memcpy(header.camera_up, value_ptr(world->cam->get_up()), sizeof(header.camera_up));
+	memcpy(header.light_position, value_ptr(world->lamp->get_location()), sizeof(header.light_position));
+	memcpy(header.plane_model, value_ptr(world->projection_plane->get_model()), sizeof(header.plane_model));
+
+	auto materials = std::vector<scene_material>();
+	auto shapes = std::vector<scene_shape_record>();
+	auto mesh_order = std::map<const mesh*, uint32_t>();
+	auto mesh_list = std::vector<const mesh*>();
+	header.plane_material = material_index(materials, world->projection_plane->get_material());
+	for (const auto item : world->shapes)
+	{
+		auto record = scene_shape_record();
+		record.material = material_index(materials, item->get_material());
+		memcpy(record.model, value_ptr(item->get_model()), sizeof(record.model));
+		if (dynamic_cast<const wall*>(item) != nullptr)
+		{
+			record.type = scene_shape::wall;
+		}
+		else if (dynamic_cast<const cuboid*>(item) != nullptr)
+		{
+			record.type = scene_shape::cuboid;
+		}
+		else if (const auto ball = dynamic_cast<const sphere*>(item))
+		{
+			record.type = scene_shape::sphere;
+			record.detail = uint32_t(ball->get_density());
+		}
+		else
+		{
+			record.type = scene_shape::mesh;
+			const auto entry = mesh_order.insert(std::make_pair(item->get_mesh(), uint32_t(mesh_list.size())));
+			if (entry.second)
+			{
+				mesh_list.push_back(item->get_mesh());
+			}
+			record.detail = entry.first->second;
+		}
+		shapes.push_back(record);
+	}
+	header.material_count = uint32_t(materials.size());
+	header.shape_count = uint32_t(shapes.size());
+	header.mesh_count = uint32_t(mesh_list.size());
+
+	// header, then the three tables, then every mesh's arrays
+	auto blob = std::vector<unsigned char>(sizeof(scene_header));
+	header.materials = append_array(blob, materials.data(), materials.size() * sizeof(scene_material));
+	header.shapes = append_array(blob, shapes.data(), shapes.size() * sizeof(scene_shape_record));
+	header.meshes = append_array(blob, nullptr, mesh_list.size() * sizeof(scene_mesh));
+	for (auto i = size_t(0); i < mesh_list.size(); i++)
+	{
+		const auto geometry = mesh_list[i];
+		auto boxes = std::vector<aabb>();
+		for (const auto& item : mesh_bvh::make_triangles(geometry))
+		{
+			boxes.push_back(item.bounds());
+		}
+		auto tree = bvh();
+		tree.build(boxes);
+
+		auto record = scene_mesh();
+		record.position_count = uint32_t(geometry->get_positions().size());
+		record.normal_count = uint32_t(geometry->get_normals().size());
+		record.index_count = uint32_t(geometry->get_indices().size());
+		record.node_count = uint32_t(tree.get_nodes().size());
+		record.order_count = uint32_t(tree.get_indices().size());
+		record.positions = append_array(blob, geometry->get_positions().data(), record.position_count * sizeof(vec3));
+		record.normals = append_array(blob, geometry->get_normals().data(), record.normal_count * sizeof(vec3));
+		record.indices = append_array(blob, geometry->get_indices().data(), record.index_count * sizeof(unsigned));
+		record.nodes = append_array(blob, tree.get_nodes().data(), record.node_count * sizeof(bvh_node));
+		record.order = append_array(blob, tree.get_indices().data(), record.order_count * sizeof(int));
+		memcpy(&blob[size_t(header.meshes) + i * sizeof(scene_mesh)], &record, sizeof(record));
+	}
+	memcpy(&blob[0], &header, sizeof(header));
+	return blob;
+}
+
+inline bool write_scene_binary(const scene* world, const char* path)
+{
+	const auto blob = pack_scene(world);
+	std::ofstream file(path, std::ios::binary);
+	file.write(reinterpret_cast<const char*>(blob.data()), std::streamsize(blob.size()));
+	if (!file)
+	{
+		fprintf(stderr, "Error: could not write %s\n", path);
+		return false;
+	}
+	return true;
+}
+
+// a view of count elements at offset, empty when they would run past the end of the data
+template <typename element>
+bool map_array(const unsigned char* data, const size_t size, const uint64_t offset, const uint64_t count, array_view<element>& view)
+{
+	if (offset > size || count > (size - offset) / sizeof(element))
+	{
+		return false;
+	}
+	view = array_view<element>(reinterpret_cast<const element*>(data + offset), size_t(count));
+	return true;
+}
+
+// the scene in the size bytes at data, which must be 16 byte aligned and stay valid for as long as backing lives; meshes point
+// straight into them. Only the layout is checked, not the contents: a binary scene is trusted the way pack_scene() wrote it.
+// path only names the source in errors
+inline scene* read_scene_binary(const std::shared_ptr<const void>& backing, const unsigned char* data, const size_t size, const char* path)
+{
+	if (size < sizeof(scene_header))
+	{
+		fprintf(stderr, "Error: %s is truncated\n", path);
+		return nullptr;
+	}
+	const auto header = reinterpret_cast<const scene_header*>(data);
+	if (memcmp(header->magic, scene_magic, sizeof(scene_magic)) != 0 || header->version != scene_version)
+	{
+		fprintf(stderr, "Error: %s is not a version %u binary scene\n", path, scene_version);
+		return nullptr;
+	}
+	if (header->byte_order != scene_byte_order)
+	{
+		fprintf(stderr, "Error: %s was compiled on a machine with the other byte order\n", path);
+		return nullptr;
+	}
+	auto materials = array_view<scene_material>();
+	auto shapes = array_view<scene_shape_record>();
+	auto meshes = array_view<scene_mesh>();
+	if (!map_array(data, size, header->materials, header->material_count, materials)
+		|| !map_array(data, size, header->shapes, header->shape_count, shapes)
+		|| !map_array(data, size, header->meshes, header->mesh_count, meshes)
+		|| header->plane_material >= header->material_count)
+	{
+		fprintf(stderr, "Error: %s is truncated\n", path);
+		return nullptr;
+	}
+
+	auto world = std::unique_ptr<scene>(new scene());
+	world->cam = new camera(header->camera_angle, make_vec3(header->camera_position), make_vec3(header->camera_target), make_vec3(header->camera_up));
+	world->lamp = new light(make_vec3(header->light_position));
+	for (const auto& record : materials)
+	{
+		world->add<material>(record.absorb, record.refract, record.reflect, make_vec3(record.color));
+	}
+	world->projection_plane = new wall(world->materials[header->plane_material]);
+	world->projection_plane->set_model(make_mat4(header->plane_model));
+
+	auto geometry = std::vector<std::shared_ptr<const mesh>>();
+	for (const auto& record : meshes)
+	{
+		auto positions = array_view<vec3>();
+		auto normals = array_view<vec3>();
+		auto indices = array_view<unsigned>();
+		auto nodes = array_view<bvh_node>();
+		auto order = array_view<int>();
+		if (!map_array(data, size, record.positions, record.position_count, positions)
+			|| !map_array(data, size, record.normals, record.normal_count, normals)
+			|| !map_array(data, size, record.indices, record.index_count, indices)
+			|| !map_array(data, size, record.nodes, record.node_count, nodes)
+			|| !map_array(data, size, record.order, record.order_count, order))
+		{
+			fprintf(stderr, "Error: %s is truncated\n", path);
+			return nullptr;
+		}
+		const auto loaded = std::make_shared<mesh>(backing, positions, normals, indices);
+		loaded->set_hierarchy(nodes, order);
+		geometry.push_back(loaded);
+	}
+
+	for (const auto& record : shapes)
+	{
+		if (record.material >= header->material_count || (record.type == scene_shape::mesh && record.detail >= header->mesh_count))
+		{
+			fprintf(stderr, "Error: %s refers to a material or mesh it does not have\n", path);
+			return nullptr;
+		}
+		const auto surface = world->materials[record.material];
+		shape* item;
+		switch (record.type)
+		{
+		case scene_shape::wall:
+			item = world->add<wall>(surface);
+			break;
+		case scene_shape::cuboid:
+			item = world->add<cuboid>(surface);
+			break;
+		case scene_shape::sphere:
+			item = world->add<sphere>(surface, int(record.detail));
+			break;
+		case scene_shape::mesh:
+			item = world->add<mesh_shape>(surface, geometry[record.detail]);
+			break;
+		default:
+			fprintf(stderr, "Error: %s has a shape of unknown type %u\n", path, unsigned(record.type));
+			return nullptr;
+		}
+		item->set_model(make_mat4(record.model));
+	}
+	return world.release();
+}
+
+inline scene* load_scene_binary(const char* path)
+{
+	const auto file = std::make_shared<mapped_file>();
+	if (!file->open(path))
+	{
+		fprintf(stderr, "Error: could not map %s\n", path);
+		return nullptr;
+	}
+	return read_scene_binary(file, file->data(), file->size(), path);
+}
+
+// either form, told apart by the binary form's magic
+inline scene* load_scene(const char* path)
+{
+	char magic[sizeof(scene_magic)] = {};
+	std::ifstream file(path, std::ios::binary);
+	if (!file)
+	{
+		fprintf(stderr, "Error: could not open %s\n", path);
+		return nullptr;
+	}
+	file.read(magic, sizeof(magic));
+	file.close();
+	return memcmp(magic, scene_magic, sizeof(scene_magic)) == 0 ? load_scene_binary(path) : load_scene_text(path);
+}
+#endif
@@ -0,0 +1,150 @@
+// Transform hierarchy: every node has a transform relative to its parent and caches its world matrix and the normal matrix
+// that goes with it. Changing a node only marks it and its subtree dirty; the matrices are rebuilt the next time someone
+// asks for them, so nodes that did not move cost nothing per frame however many there are.
+#ifndef SCENE_GRAPH_H
+#define SCENE_GRAPH_H
+
+#include <glm/glm.hpp>
+#include <glm/ext.hpp>
+#include <algorithm>
+#include <vector>
+
+using namespace glm;
+
+class scene_node
+{
+	scene_node* parent_;
+	std::vector<scene_node*> children_;
+	// relative to the parent, or to the world for a node without one
+	mat4 local_;
+	// parent's world matrix times local_ and the inverse transpose of its upper 3x3; only valid while dirty_ is false.
+	// A dirty node's whole subtree is dirty too, so marking can stop at the first node that already is
+	mutable mat4 world_;
+	mutable mat3 normal_;
+	mutable bool dirty_;
+	// counts the changes to this node's own transform and parent; a node moved by an ancestor keeps its version, so
+	// telling whether anything in a scene moved means looking at every node
+	unsigned version_;
+
+	void mark_dirty()
+	{
+		this->version_++;
+		this->mark_subtree();
+	}
+
+	void mark_subtree()
+	{
+		if (this->dirty_)
+		{
+			return;
+		}
+		this->dirty_ = true;
+		for (const auto child : this->children_)
+		{
+			child->mark_subtree();
+		}
+	}
+
+	void refresh() const
+	{
+		this->world_ = this->parent_ == nullptr ? this->local_ : this->parent_->get_model() * this->local_;
+		this->normal_ = transpose(inverse(mat3(this->world_)));
+		this->dirty_ = false;
+	}
+
+public:
+	scene_node() : parent_(nullptr), local_(1.0f), world_(1.0f), normal_(1.0f), dirty_(false), version_(0) {}
+
+	scene_node(const scene_node&) = delete;
+	scene_node& operator=(const scene_node&) = delete;
+
+	// the child keeps its local transform, so it moves with the parent from now on
+	void set_parent(scene_node* parent)
+	{
+		if (this->parent_ != nullptr)
+		{
+			auto& siblings = this->parent_->children_;
+			siblings.erase(std::remove(siblings.begin(), siblings.end(), this), siblings.end());
+		}
+		this->parent_ = parent;
+		if (parent != nullptr)
+		{
+			parent->children_.push_back(this);
+		}
+		this->mark_dirty();
+	}
+
+	scene_node* get_parent() const
+	{
+		return this->parent_;
+	}
+
+	void translate(const vec3 direction)
+	{
+		this->local_ = glm::translate(this->local_, direction);
+		this->mark_dirty();
+	}
+
+	// axis needs to be in normal form
+	void rotate(const float angle, const vec3 axis)
+	{
+		this->local_ = glm::rotate(this->local_, radians(angle), axis);
+		this->mark_dirty();
+	}
+
+	void scale(const vec3 magnitude)
+	{
+		this->local_ = glm::scale(this->local_, magnitude);
+		this->mark_dirty();
+	}
+
+	// replaces the transform relative to the parent, e.g. with one read back from a scene file
+	void set_model(const mat4& model)
+	{
+		this->local_ = model;
+		this->mark_dirty();
+	}
+
+	const mat4& get_local() const
+	{
+		return this->local_;
+	}
+
+	unsigned get_version() const
+	{
+		return this->version_;
+	}
+
+	// local to world; not safe to call from several threads while the node is dirty
+	const mat4& get_model() const
+	{
+		if (this->dirty_)
+		{
+			this->refresh();
+		}
+		return this->world_;
+	}
+
+	// takes normals to world space
+	const mat3& get_normal_matrix() const
+	{
+		if (this->dirty_)
+		{
+			this->refresh();
+		}
+		return this->normal_;
+	}
+
+	// leaves the parent, and the children become roots; their world matrices lose this node's transform, which counts as a
+	// change of parent
+	virtual ~scene_node()
+	{
+		this->set_parent(nullptr);
+		for (const auto child : this->children_)
+		{
+			child->parent_ = nullptr;
+			child->mark_dirty();
+		}
+	}
+};
+#endif
@@ -0,0 +1,196 @@
+// Hands image tiles to worker threads: tiles are laid out along a Morton curve, every thread owns a contiguous run of them
+// in its own queue and threads that run dry steal half of another thread's remaining tiles from the far end. Queues are sized
+// for every tile up front, so handing out tiles never allocates.
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include <algorithm>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+const int tile_size = 32;
+
+struct tile
+{
+	int x;
+	int y;
+	int width;
+	int height;
+};
+
+class tile_scheduler
+{
+	struct tile_queue
+	{
+		std::mutex lock;
+		// tiles[head, end) are still to be done
+		std::vector<int> tiles;
+		size_t head;
+		// tiles taken from another queue on their way into this one
+		std::vector<int> stolen;
+
+		explicit tile_queue(const size_t capacity) : head(0)
+		{
+			this->tiles.reserve(capacity);
+			this->stolen.reserve(capacity);
+		}
+
+		bool empty() const
+		{
+			return this->head == this->tiles.size();
+		}
+
+		size_t size() const
+		{
+			return this->tiles.size() - this->head;
+		}
+	};
+
+	std::vector<tile> tiles_;
+	std::vector<std::unique_ptr<tile_queue>> queues_;
+
+	// interleaves the bits of x and y
+	static unsigned morton(const unsigned x, const unsigned y)
+	{
+		auto code = 0u;
+		for (auto bit = 0u; bit < 16u; bit++)
+		{
+			code |= ((x >> bit) & 1u) << (2u * bit);
+			code |= ((y >> bit) & 1u) << (2u * bit + 1u);
+		}
+		return code;
+	}
+
+	bool pop(const unsigned worker, int& index)
+	{
+		auto& own = *this->queues_[worker];
+		std::lock_guard<std::mutex> guard(own.lock);
+		if (own.empty())
+		{
+			return false;
+		}
+		index = own.tiles[own.head++];
+		return true;
+	}
+
+	// takes the back half of the first non empty victim, keeps one tile and queues the rest locally; only called once the
+	// worker's own queue is empty, so it can start over from the front of its storage
+	bool steal(const unsigned worker, int& index)
+	{
+		const auto count = unsigned(this->queues_.size());
+		auto& own = *this->queues_[worker];
+		auto& stolen = own.stolen;
+		for (auto offset = 1u; offset < count; offset++)
+		{
+			auto& victim = *this->queues_[(worker + offset) % count];
+			stolen.clear();
+			{
+				std::lock_guard<std::mutex> guard(victim.lock);
+				const auto take = (victim.size() + 1) / 2;
+				for (auto i = size_t(0); i < take; i++)
+				{
+					stolen.push_back(victim.tiles.back());
+					victim.tiles.pop_back();
+				}
+			}
+			if (stolen.empty())
+			{
+				continue;
+			}
+			index = stolen.back();
+			stolen.pop_back();
+			std::lock_guard<std::mutex> guard(own.lock);
+			own.tiles.clear();
+			own.head = 0;
+			own.tiles.insert(own.tiles.end(), stolen.rbegin(), stolen.rend());
+			return true;
+		}
+		return false;
+	}
+
+	// appends region split into tiles, in curve order starting from its corner
+	void add_region(const tile& region)
+	{
+		const auto first = this->tiles_.size();
+		for (auto y = 0; y < region.height; y += tile_size)
+		{
+			for (auto x = 0; x < region.width; x += tile_size)
+			{
+				this->tiles_.push_back({ region.x + x, region.y + y, std::min(tile_size, region.width - x), std::min(tile_size, region.height - y) });
+			}
+		}
+		std::sort(this->tiles_.begin() + first, this->tiles_.end(), [&region](const tile& left, const tile& right)
+		{
+			return morton((left.x - region.x) / tile_size, (left.y - region.y) / tile_size)
+				< morton((right.x - region.x) / tile_size, (right.y - region.y) / tile_size);
+		});
+	}
+
+public:
+	tile_scheduler(const int width, const int height)
+	{
+		this->tiles_.reserve(size_t((width + tile_size - 1) / tile_size) * ((height + tile_size - 1) / tile_size));
+		this->add_region({ 0, 0, width, height });
+	}
+
+	// the tiles of several regions, one after another, shared by the same threads
+	explicit tile_scheduler(const std::vector<tile>& regions)
+	{
+		for (const auto& region : regions)
+		{
+			this->add_region(region);
+		}
+	}
+
+	const std::vector<tile>& get_tiles() const
+	{
+		return this->tiles_;
+	}
+
+	static unsigned default_threads()
+	{
+		return std::max(1u, std::thread::hardware_concurrency());
+	}
+
+	// work(tile, worker) is called once for every tile; returns when all of them are done
+	template <typename tile_work>
+	void run(unsigned threads, tile_work work)
+	{
+		if (threads == 0)
+		{
+			threads = default_threads();
+		}
+		threads = std::max(1u, std::min(threads, unsigned(this->tiles_.size())));
+		this->queues_.clear();
+		for (auto i = 0u; i < threads; i++)
+		{
+			this->queues_.emplace_back(new tile_queue(this->tiles_.size()));
+		}
+		// contiguous runs of the curve keep each thread's tiles close together on screen
+		const auto count = unsigned(this->tiles_.size());
+		for (auto i = 0u; i < count; i++)
+		{
+			this->queues_[size_t(i) * threads / count]->tiles.push_back(int(i));
+		}
+
+		auto workers = std::vector<std::thread>();
+		for (auto worker = 0u; worker < threads; worker++)
+		{
+			workers.emplace_back([this, worker, &work]()
+			{
+				auto index = 0;
+				while (this->pop(worker, index) || this->steal(worker, index))
+				{
+					work(this->tiles_[index], worker);
+				}
+			});
+		}
+		for (auto& worker : workers)
+		{
+			worker.join();
+		}
+	}
+};
+#endif
@@ -1,391 +1,245 @@
-// Shapes will be created in local space and will contain model matrix and then transformed (translate, rotate, etc.) in world space
-#include <glm/glm.hpp>
-#include <glm/ext.hpp>
-#include <../src/structs.cpp>
-#include <../headers/shaders.hpp>
-#include <../src/material.cpp>
-#include <glad/glad.h>
-#include <vector>
-
-const double pi = 3.1415926535897;
-
-
-class shape
-{
-public:
-	virtual void sculpt(vec3) = 0;
-	virtual void translate(vec3, bool = false) = 0;
-	virtual void rotate(float, vec3, bool = false) = 0;
-	virtual void scale(vec3, bool = false) = 0;
-	virtual void draw(const shaders*) = 0;
-	virtual ~shape() {}
-};
-
-class wall : public shape
-{
-	point* vertices_;
-	mat4 model_{};
-	mat4 memory_model_{};
-	material* material_;
-	int number_of_vertices_;
-
-public:
-	wall(const material* mat)
-	{
-		this->number_of_vertices_ = 6;
-		this->vertices_ = new point[this->number_of_vertices_ * 3];
-
-		this->vertices_[0] = point(-0.5f, -0.5f, 0.0f);
-		this->vertices_[3] = point(0.5f, -0.5f, 0.0f);
-		this->vertices_[6] = point(-0.5f, 0.5f, 0.0f);
-
-		this->vertices_[9] = point(0.5f, 0.5f, 0.0f);
-		this->vertices_[12] = point(0.5f, -0.5f, 0.0f);
-		this->vertices_[15] = point(-0.5f, 0.5f, 0.0f);
-
-		for (auto i = 2; i < this->number_of_vertices_ * 3; i += 3)
-		{
-			this->vertices_[i] = point(0, 0, 1);
-		}
-		for (auto i = 1; i < this->number_of_vertices_ * 3; i += 3)
-		{
-			this->vertices_[i] = point(mat->dye().r, mat->dye().g, mat->dye().b);
-		}
-
-		this->model_ = mat4(1.0f);
-		this->memory_model_ = mat4(1.0f);
-
-		this->material_ = new material(mat->absorb(), mat->refract(), mat->reflect(), mat->dye());
-	}
-
-	void sculpt(const vec3 dimensions) override
-	{
-		this->scale(dimensions, true);
-	}
-
-	void translate(const vec3 direction, const bool forever) override
-	{
-		this->model_ = glm::translate(this->model_, direction);
-		if (forever)
-		{
-			this->memory_model_ = glm::translate(this->memory_model_, direction);
-		}
-	}
-
-	void rotate(const float angle, const vec3 axis, const bool forever) override
-	{
-		// axis needs to be in normal form
-		this->model_ = glm::rotate(this->model_, radians(angle), axis);
-		if (forever)
-		{
-			this->memory_model_ = glm::rotate(this->memory_model_, radians(angle), axis);
-		}
-	}
-
-	void scale(const vec3 vec, const bool forever) override
-	{
-		this->model_ = glm::scale(this->model_, vec);
-		if (forever)
-		{
-			this->memory_model_ = glm::scale(this->memory_model_, vec);
-		}
-	}
-
-	void draw(const shaders* shader) override
-	{
-		shader->feed_mat("model", this->model_);
-		shader->feed_vec("material.ambient", this->material_->dye());
-		shader->feed_vec("material.diffuse", this->material_->dye());
-		shader->feed_vec("material.specular", vec3(0.5f));
-		shader->feed_float("material.shininess", 128.0f);
-
-		glBufferData(GL_ARRAY_BUFFER, sizeof(point) * this->number_of_vertices_ * 3, this->vertices_, GL_STATIC_DRAW);
-		glDrawArrays(GL_TRIANGLES, 0, this->number_of_vertices_);
-
-		this->model_ = mat4(this->memory_model_);
-	}
-
-	vec3 get_corner(int bottom, int top) const
-	{
-		if (bottom != 0 && bottom != 1)
-		{
-			bottom = 0;
-		}
-		if (top != 0 && top != 1)
-		{
-			top = 0;
-		}
-		const auto index = bottom * 3 + top * 6;
-		return this->model_ * vec4(this->vertices_[index].x, this->vertices_[index].y, this->vertices_[index].z, 1.0f);
-	}
-
-	~wall()
-	{
-		delete this->vertices_;
-		delete this->material_;
-	}
-};
-
-class cuboid : public shape
-{
-	point* vertices_;
-	int number_of_vertices_;
-	mat4 model_{};
-	mat4 memory_model_{};
-	material* material_;
-
-public:
-	cuboid(const material* mat)
-	{
-		this->number_of_vertices_ = 36;
-		this->vertices_ = new point[this->number_of_vertices_ * 3];
-
-		// floor
-		this->vertices_[0] = point(-0.5f, -0.5f, -0.5f);
-		this->vertices_[3] = point(0.5f, -0.5f, -0.5f);
-		this->vertices_[6] = point(0.5f, 0.5f, -0.5f);
-		this->vertices_[9] = point(-0.5f, -0.5f, -0.5f);
-		this->vertices_[12] = point(0.5f, 0.5f, -0.5f);
-		this->vertices_[15] = point(-0.5f, 0.5f, -0.5f);
-		for (auto i = 2; i < 18; i += 3)
-		{
-			this->vertices_[i] = point(0, 0, -1);
-		}
-		// front wall
-		this->vertices_[18] = point(-0.5f, -0.5f, -0.5f);
-		this->vertices_[21] = point(0.5, -0.5f, -0.5f);
-		this->vertices_[24] = point(0.5, -0.5f, 0.5);
-		this->vertices_[27] = point(-0.5f, -0.5f, -0.5f);
-		this->vertices_[30] = point(0.5, -0.5f, 0.5);
-		this->vertices_[33] = point(-0.5f, -0.5f, 0.5);
-		for (auto i = 20; i < 36; i += 3)
-		{
-			this->vertices_[i] = point(0, -1, 0);
-		}
-		// left wall
-		this->vertices_[36] = point(-0.5f, -0.5f, -0.5f);
-		this->vertices_[39] = point(-0.5f, 0.5, -0.5f);
-		this->vertices_[42] = point(-0.5f, 0.5, 0.5);
-		this->vertices_[45] = point(-0.5f, -0.5f, -0.5f);
-		this->vertices_[48] = point(-0.5f, 0.5, 0.5);
-		this->vertices_[51] = point(-0.5f, -0.5f, 0.5);
-		for (auto i = 38; i < 54; i += 3)
-		{
-			this->vertices_[i] = point(-1, 0, 0);
-		}
-		// right wall
-		this->vertices_[54] = point(0.5, -0.5f, -0.5f);
-		this->vertices_[57] = point(0.5, 0.5, -0.5f);
-		this->vertices_[60] = point(0.5, 0.5, 0.5);
-		this->vertices_[63] = point(0.5, -0.5f, -0.5f);
-		this->vertices_[66] = point(0.5, 0.5, 0.5);
-		this->vertices_[69] = point(0.5, -0.5f, 0.5);
-		for (auto i = 56; i < 72; i += 3)
-		{
-			this->vertices_[i] = point(1, 0, 0);
-		}
-		// bottom wall
-		this->vertices_[72] = point(-0.5f, 0.5, -0.5f);
-		this->vertices_[75] = point(0.5, 0.5, -0.5f);
-		this->vertices_[78] = point(0.5, 0.5, 0.5);
-		this->vertices_[81] = point(-0.5f, 0.5, -0.5f);
-		this->vertices_[84] = point(0.5, 0.5, 0.5);
-		this->vertices_[87] = point(-0.5f, 0.5, 0.5);
-		for (auto i = 74; i < 90; i += 3)
-		{
-			this->vertices_[i] = point(0, 1, 0);
-		}
-		// ceiling
-		this->vertices_[90] = point(-0.5f, -0.5f, 0.5);
-		this->vertices_[93] = point(0.5, -0.5f, 0.5);
-		this->vertices_[96] = point(0.5, 0.5, 0.5);
-		this->vertices_[99] = point(-0.5f, -0.5f, 0.5);
-		this->vertices_[102] = point(0.5, 0.5, 0.5);
-		this->vertices_[105] = point(-0.5f, 0.5, 0.5);
-		for (auto i = 92; i < 108; i += 3)
-		{
-			this->vertices_[i] = point(0, 0, 1);
-		}
-		for (auto i = 1; i < this->number_of_vertices_ * 3; i += 3)
-		{
-			this->vertices_[i] = point(mat->dye().r, mat->dye().g, mat->dye().b);
-		}
-
-		this->model_ = mat4(1.0f);
-		this->memory_model_ = mat4(1.0f);
-
-		this->material_ = new material(mat->absorb(), mat->refract(), mat->reflect(), mat->dye());
-	}
-
-	void sculpt(const vec3 dimensions) override
-	{
-		this->scale(dimensions, true);
-	}
-
-	void translate(const vec3 direction, const bool forever) override
-	{
-		this->model_ = glm::translate(this->model_, direction);
-		if (forever)
-		{
-			this->memory_model_ = glm::translate(this->memory_model_, direction);
-		}
-	}
-
-	void rotate(const float angle, const vec3 axis, const bool forever) override
-	{
-		// axis needs to be in normal form
-		this->model_ = glm::rotate(this->model_, radians(angle), axis);
-		if (forever)
-		{
-			this->memory_model_ = glm::rotate(this->memory_model_, radians(angle), axis);
-		}
-	}
-
-	void scale(const vec3 vec, const bool forever) override
-	{
-		this->model_ = glm::scale(this->model_, vec);
-		if (forever)
-		{
-			this->memory_model_ = glm::scale(this->memory_model_, vec);
-		}
-	}
-
-	void draw(const shaders* shader) override
-	{
-		shader->feed_mat("model", this->model_);
-		shader->feed_vec("material.ambient", this->material_->dye());
-		shader->feed_vec("material.diffuse", this->material_->dye());
-		shader->feed_vec("material.specular", vec3(0.5f));
-		shader->feed_float("material.shininess", 128.0f);
-
-		glBufferData(GL_ARRAY_BUFFER, sizeof(point) * this->number_of_vertices_ * 3, this->vertices_, GL_STATIC_DRAW);
-		glDrawArrays(GL_TRIANGLES, 0, this->number_of_vertices_);
-
-		this->model_ = mat4(this->memory_model_);
-	}
-
-	~cuboid()
-	{
-		delete this->vertices_;
-		delete this->material_;
-	}
-};
-
-class sphere : public shape
-{
-	point* vertices_;
-	int number_of_vertices_;
-	mat4 model_{};
-	mat4 memory_model_{};
-	material* material_;
-
-public:
-	sphere(const material* mat, const int density)
-	{
-		auto vertices = std::vector<point>();
-		for (auto i = -(density / 2); i < density / 2; i++)
-		{
-			for (auto j = 0; j < density; j++)
-			{
-				const auto phi = i * (glm::pi<float>() / density);
-				const auto phi_next = (i + 1) * (glm::pi<float>() / density);
-				const auto theta = j * 2 * glm::pi<float>() / density;
-				const auto theta_next = (j + 1) * 2 * glm::pi<float>() / density;
-
-				vertices.emplace_back(cos(phi) * cos(theta), cos(phi) * sin(theta), sin(phi));
-				vertices.emplace_back(mat->dye().x, mat->dye().y, mat->dye().z);
-				vertices.emplace_back(cos(phi) * cos(theta), cos(phi) * sin(theta), sin(phi));
-
-				vertices.emplace_back(cos(phi_next) * cos(theta), cos(phi_next) * sin(theta), sin(phi_next));
-				vertices.emplace_back(mat->dye().x, mat->dye().y, mat->dye().z);
-				vertices.emplace_back(cos(phi_next) * cos(theta), cos(phi_next) * sin(theta), sin(phi_next));
-
-				vertices.emplace_back(cos(phi_next) * cos(theta_next), cos(phi_next) * sin(theta_next), sin(phi_next));
-				vertices.emplace_back(mat->dye().x, mat->dye().y, mat->dye().z);
-				vertices.emplace_back(cos(phi_next) * cos(theta_next), cos(phi_next) * sin(theta_next), sin(phi_next));
-
-				vertices.emplace_back(cos(phi) * cos(theta), cos(phi) * sin(theta), sin(phi));
-				vertices.emplace_back(mat->dye().x, mat->dye().y, mat->dye().z);
-				vertices.emplace_back(cos(phi) * cos(theta), cos(phi) * sin(theta), sin(phi));
-
-				vertices.emplace_back(cos(phi_next) * cos(theta_next), cos(phi_next) * sin(theta_next), sin(phi_next));
-				vertices.emplace_back(mat->dye().x, mat->dye().y, mat->dye().z);
-				vertices.emplace_back(cos(phi_next) * cos(theta_next), cos(phi_next) * sin(theta_next), sin(phi_next));
-
-				vertices.emplace_back(cos(phi) * cos(theta_next), cos(phi) * sin(theta_next), sin(phi));
-				vertices.emplace_back(mat->dye().x, mat->dye().y, mat->dye().z);
-				vertices.emplace_back(cos(phi) * cos(theta_next), cos(phi) * sin(theta_next), sin(phi));
-			}
-		}
-
-		this->vertices_ = new point[vertices.size()];
-		this->number_of_vertices_ = float(vertices.size() / 3);
-		for (auto i = 0; i < int(vertices.size()); i++)
-		{
-			this->vertices_[i] = point(vertices[i].x, vertices[i].y, vertices[i].z);
-		}
-
-		this->model_ = mat4(1.0f);
-		this->memory_model_ = mat4(1.0f);
-
-		this->material_ = new material(mat->absorb(), mat->refract(), mat->reflect(), mat->dye());
-	}
-
-	void sculpt(const vec3 dimensions) override
-	{
-		this->scale(dimensions, true);
-	}
-
-	void translate(const vec3 direction, const bool forever) override
-	{
-		this->model_ = glm::translate(this->model_, direction);
-		if (forever)
-		{
-			this->memory_model_ = glm::translate(this->memory_model_, direction);
-		}
-	}
-
-	void rotate(const float angle, const vec3 axis, const bool forever) override
-	{
-		// axis needs to be in normal form
-		this->model_ = glm::rotate(this->model_, radians(angle), axis);
-		if (forever)
-		{
-			this->memory_model_ = glm::rotate(this->memory_model_, radians(angle), axis);
-		}
-	}
-
-	void scale(const vec3 vec, const bool forever) override
-	{
-		this->model_ = glm::scale(this->model_, vec);
-		if (forever)
-		{
-			this->memory_model_ = glm::scale(this->memory_model_, vec);
-		}
-	}
-
-	void draw(const shaders* shader) override
-	{
-		shader->feed_mat("model", this->model_);
-		shader->feed_vec("material.ambient", this->material_->dye());
-		shader->feed_vec("material.diffuse", this->material_->dye());
-		shader->feed_vec("material.specular", vec3(0.3f));
-		shader->feed_float("material.shininess", 128.0f);
-
-		glBufferData(GL_ARRAY_BUFFER, sizeof(point) * this->number_of_vertices_ * 3, this->vertices_, GL_STATIC_DRAW);
-		glDrawArrays(GL_TRIANGLES, 0, this->number_of_vertices_);
-
-		this->model_ = mat4(this->memory_model_);
-	}
-
-	vec3 get_centre() const
-	{
-		return this->model_ * vec4(0.0f, 0.0f, 0.0f, 1.0);
-	}
-
-	~sphere()
-	{
-		delete this->vertices_;
-		delete this->material_;
-	}
-};
\ No newline at end of file
+// Shapes are created in local space and are scene nodes, so they are placed (translate, rotate, etc.) relative to their parent
+#ifndef SHAPES_H
+#define SHAPES_H
+
+#include <glm/glm.hpp>
+#include <glm/ext.hpp>
+#include <../src/structs.cpp>
+#include <../headers/shaders.hpp>
+#include <../src/material.cpp>
+#include <../src/mesh.cpp>
+#include <../src/render_queue.cpp>
+#include <../src/scene_graph.cpp>
+#include <glad/glad.h>
+#include <vector>
+
+const double pi = 3.1415926535897;
+// the preview draws a sphere with the coarsest of its meshes whose slices are at most this many pixels long around its outline
+const float sphere_lod_edge_pixels = 6.0f;
+// coarser meshes halve the density until the next would fall below this
+const int sphere_lod_min_density = 8;
+
+
+class shape : public scene_node
+{
+public:
+	void sculpt(const vec3 dimensions)
+	{
+		this->scale(dimensions);
+	}
+
+	// queues the shape for the raster preview with its cached world and normal matrices
+	virtual void draw(render_queue*, const shaders*) = 0;
+	// local space geometry, shared with every other shape of the same kind
+	virtual const mesh* get_mesh() const = 0;
+	// not owned, the material has to outlive the shape; a scene's materials live as long as its shapes
+	virtual const material* get_material() const = 0;
+};
+
+class wall : public shape
+{
+	std::shared_ptr<const mesh> mesh_;
+	const material* material_;
+
+public:
+	wall(const material* mat)
+	{
+		this->mesh_ = shared_mesh(mesh_type::wall);
+
+		this->material_ = mat;
+	}
+
+	void draw(render_queue* queue, const shaders* shader) override
+	{
+		queue->submit({ shader, this->material_, 0.5f, this->mesh_.get(), this->get_model(), this->get_normal_matrix() });
+	}
+
+	vec3 get_corner(int bottom, int top) const
+	{
+		if (bottom != 0 && bottom != 1)
+		{
+			bottom = 0;
+		}
+		if (top != 0 && top != 1)
+		{
+			top = 0;
+		}
+		return this->get_model() * vec4(this->mesh_->get_positions()[bottom + top * 2], 1.0f);
+	}
+
+	const mesh* get_mesh() const override
+	{
+		return this->mesh_.get();
+	}
+
+	const material* get_material() const override
+	{
+		return this->material_;
+	}
+};
+
+class cuboid : public shape
+{
+	std::shared_ptr<const mesh> mesh_;
+	const material* material_;
+
+public:
+	cuboid(const material* mat)
+	{
+		this->mesh_ = shared_mesh(mesh_type::cuboid);
+
+		this->material_ = mat;
+	}
+
+	void draw(render_queue* queue, const shaders* shader) override
+	{
+		queue->submit({ shader, this->material_, 0.5f, this->mesh_.get(), this->get_model(), this->get_normal_matrix() });
+	}
+
+	const mesh* get_mesh() const override
+	{
+		return this->mesh_.get();
+	}
+
+	const material* get_material() const override
+	{
+		return this->material_;
+	}
+};
+
+class sphere : public shape
+{
+	// the mesh is only needed by the raster preview, the ray tracer intersects the sphere analytically
+	mutable std::shared_ptr<const mesh> mesh_;
+	// coarser meshes for when the sphere looks small, made the first time they are needed; like mesh_ they are shared with
+	// every sphere of the same density
+	mutable std::vector<std::shared_ptr<const mesh>> levels_;
+	int density_;
+	const material* material_;
+
+	// the mesh whose slices come closest to sphere_lod_edge_pixels on an outline screen_radius pixels across, never finer
+	// than the density the sphere was made with
+	const mesh* get_level(const float screen_radius) const
+	{
+		const auto wanted = 2.0f * glm::pi<float>() * screen_radius / sphere_lod_edge_pixels;
+		auto density = this->density_;
+		auto level = size_t(0);
+		for (;;)
+		{
+			// kept even, make_sphere_mesh would round an odd density up and make a finer mesh than the level asks for
+			const auto coarser = (density / 2) & ~1;
+			if (coarser < sphere_lod_min_density || float(coarser) < wanted)
+			{
+				break;
+			}
+			density = coarser;
+			level++;
+		}
+		if (level == 0)
+		{
+			return this->get_mesh();
+		}
+		if (this->levels_.size() < level)
+		{
+			this->levels_.resize(level);
+		}
+		auto& coarse = this->levels_[level - 1];
+		if (!coarse)
+		{
+			coarse = shared_mesh(mesh_type::sphere, density);
+		}
+		return coarse.get();
+	}
+
+public:
+	sphere(const material* mat, const int density)
+	{
+		this->density_ = density;
+
+		this->material_ = mat;
+	}
+
+	// the fewer pixels the sphere covers, the coarser the mesh it is drawn with
+	void draw(render_queue* queue, const shaders* shader) override
+	{
+		const auto& model = this->get_model();
+		const auto radius = max(length(vec3(model[0])), max(length(vec3(model[1])), length(vec3(model[2]))));
+		const auto geometry = this->get_level(queue->get_screen_radius(this->get_centre(), radius));
+		queue->submit({ shader, this->material_, 0.3f, geometry, model, this->get_normal_matrix() });
+	}
+
+	vec3 get_centre() const
+	{
+		return this->get_model() * vec4(0.0f, 0.0f, 0.0f, 1.0);
+	}
+
+	// only meaningful while the sphere is scaled the same along every axis
+	float get_radius() const
+	{
+		return length(vec3(this->get_model()[0]));
+	}
+
+	int get_density() const
+	{
+		return this->density_;
+	}
+
+	bool is_round() const
+	{
+		const auto& model = this->get_model();
+		const auto x = length(vec3(model[0]));
+		const auto y = length(vec3(model[1]));
+		const auto z = length(vec3(model[2]));
+		return abs(x - y) <= 1e-4f * x && abs(x - z) <= 1e-4f * x;
+	}
+
+	const mesh* get_mesh() const override
+	{
+		if (!this->mesh_)
+		{
+			this->mesh_ = shared_mesh(mesh_type::sphere, this->density_);
+		}
+		return this->mesh_.get();
+	}
+
+	const material* get_material() const override
+	{
+		return this->material_;
+	}
+};
+
+// any indexed triangle mesh in local space, e.g. one loaded from a scene file
+class mesh_shape : public shape
+{
+	std::shared_ptr<const mesh> mesh_;
+	const material* material_;
+
+public:
+	mesh_shape(const material* mat, const std::shared_ptr<const mesh>& geometry)
+	{
+		this->mesh_ = geometry;
+
+		this->material_ = mat;
+	}
+
+	void draw(render_queue* queue, const shaders* shader) override
+	{
+		queue->submit({ shader, this->material_, 0.5f, this->mesh_.get(), this->get_model(), this->get_normal_matrix() });
+	}
+
+	const mesh* get_mesh() const override
+	{
+		return this->mesh_.get();
+	}
+
+	std::shared_ptr<const mesh> get_shared_mesh() const
+	{
+		return this->mesh_;
+	}
+
+	const material* get_material() const override
+	{
+		return this->material_;
+	}
+};
+#endif
\ No newline at end of file
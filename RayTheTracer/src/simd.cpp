@@ -0,0 +1,684 @@
+// Vectorised intersection kernels: 8 ray packets against one primitive for coherent rays, one ray against 8 triangles for incoherent ones.
+// Every kernel has a scalar, an SSE (two 4 wide halves) and an AVX2 version; the widest one the CPU supports is picked once at startup.
+#ifndef SIMD_H
+#define SIMD_H
+
+#include <../src/bvh.cpp>
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define SIMD_AVX2
+#else
+#include <cpuid.h>
+#define SIMD_AVX2 __attribute__((target("avx2")))
+#endif
+
+const int packet_width = 8;
+const float determinant_epsilon = 1e-9f;
+
+enum class simd_level
+{
+	scalar,
+	sse,
+	avx2
+};
+
+inline const char* simd_name(const simd_level level)
+{
+	switch (level)
+	{
+	case simd_level::avx2:
+		return "avx2";
+	case simd_level::sse:
+		return "sse";
+	default:
+		return "scalar";
+	}
+}
+
+inline simd_level detect_simd()
+{
+	int registers[4];
+#if defined(_MSC_VER)
+	__cpuid(registers, 0);
+	const auto highest = registers[0];
+	__cpuid(registers, 1);
+	const auto features = registers[3];
+	const auto extended = registers[2];
+	auto leaf7 = 0;
+	if (highest >= 7)
+	{
+		__cpuidex(registers, 7, 0);
+		leaf7 = registers[1];
+	}
+	// the OS has to save the ymm registers on context switches as well
+	const auto os_avx = (extended & (1 << 27)) != 0 && (_xgetbv(0) & 6) == 6;
+#else
+	unsigned a, b, c, d;
+	__cpuid(0, a, b, c, d);
+	const auto highest = int(a);
+	__cpuid(1, a, b, c, d);
+	const auto features = int(d);
+	const auto extended = int(c);
+	auto leaf7 = 0;
+	if (highest >= 7)
+	{
+		__cpuid_count(7, 0, a, b, c, d);
+		leaf7 = int(b);
+	}
+	auto os_avx = false;
+	if ((extended & (1 << 27)) != 0)
+	{
+		unsigned low, high;
+		__asm__("xgetbv" : "=a"(low), "=d"(high) : "c"(0));
+		os_avx = (low & 6) == 6;
+	}
+#endif
+	(void)registers;
+	if (os_avx && (extended & (1 << 28)) != 0 && (leaf7 & (1 << 5)) != 0)
+	{
+		return simd_level::avx2;
+	}
+	if ((features & (1 << 26)) != 0)
+	{
+		return simd_level::sse;
+	}
+	return simd_level::scalar;
+}
+
+// structure of arrays, lanes past the end of a row are switched off with a negative distance
+struct alignas(32) ray_packet
+{
+	float origin_x[packet_width];
+	float origin_y[packet_width];
+	float origin_z[packet_width];
+	float direction_x[packet_width];
+	float direction_y[packet_width];
+	float direction_z[packet_width];
+	float inverse_x[packet_width];
+	float inverse_y[packet_width];
+	float inverse_z[packet_width];
+	float distance[packet_width];
+	float u[packet_width];
+	float v[packet_width];
+	int triangle[packet_width];
+	int sphere[packet_width];
+	// the instance whose mesh the triangle index refers to
+	int instance[packet_width];
+	// used to order children during traversal
+	vec3 mean_direction;
+
+	void set(const int lane, const ray& r)
+	{
+		this->origin_x[lane] = r.origin.x;
+		this->origin_y[lane] = r.origin.y;
+		this->origin_z[lane] = r.origin.z;
+		this->direction_x[lane] = r.direction.x;
+		this->direction_y[lane] = r.direction.y;
+		this->direction_z[lane] = r.direction.z;
+		this->inverse_x[lane] = r.inverse_direction.x;
+		this->inverse_y[lane] = r.inverse_direction.y;
+		this->inverse_z[lane] = r.inverse_direction.z;
+		this->distance[lane] = FLT_MAX;
+		this->u[lane] = 0.0f;
+		this->v[lane] = 0.0f;
+		this->triangle[lane] = -1;
+		this->sphere[lane] = -1;
+		this->instance[lane] = -1;
+	}
+
+	void disable(const int lane)
+	{
+		this->set(lane, ray(vec3(0.0f), vec3(0.0f, 0.0f, 1.0f)));
+		this->distance[lane] = -1.0f;
+	}
+
+	bool active(const int lane) const
+	{
+		return this->distance[lane] >= 0.0f;
+	}
+
+	ray get_ray(const int lane) const
+	{
+		return ray(vec3(this->origin_x[lane], this->origin_y[lane], this->origin_z[lane]), vec3(this->direction_x[lane], this->direction_y[lane], this->direction_z[lane]));
+	}
+};
+
+// up to 8 triangles of one leaf in structure of arrays form, unused lanes are degenerate and never hit
+struct triangle_block
+{
+	float a_x[packet_width];
+	float a_y[packet_width];
+	float a_z[packet_width];
+	float ab_x[packet_width];
+	float ab_y[packet_width];
+	float ab_z[packet_width];
+	float ac_x[packet_width];
+	float ac_y[packet_width];
+	float ac_z[packet_width];
+
+	triangle_block(const triangle* triangles, const int count)
+	{
+		for (auto lane = 0; lane < packet_width; lane++)
+		{
+			const auto used = lane < count;
+			const auto a = used ? triangles[lane].a : vec3(0.0f);
+			const auto ab = used ? triangles[lane].edge_ab : vec3(0.0f);
+			const auto ac = used ? triangles[lane].edge_ac : vec3(0.0f);
+			this->a_x[lane] = a.x;
+			this->a_y[lane] = a.y;
+			this->a_z[lane] = a.z;
+			this->ab_x[lane] = ab.x;
+			this->ab_y[lane] = ab.y;
+			this->ab_z[lane] = ab.z;
+			this->ac_x[lane] = ac.x;
+			this->ac_y[lane] = ac.y;
+			this->ac_z[lane] = ac.z;
+		}
+	}
+};
+
+// result of a single ray against a block: the winning lane or -1
+struct block_hit
+{
+	int lane;
+	float distance;
+	float u;
+	float v;
+};
+
+struct simd_kernels
+{
+	simd_level level;
+	block_hit (*intersect_block)(const triangle_block&, const ray&, float);
+	void (*intersect_packet_triangle)(ray_packet&, const triangle&, int);
+	void (*intersect_packet_sphere)(ray_packet&, const sphere_primitive&, int);
+	bool (*intersect_packet_box)(const ray_packet&, const bvh_node&);
+};
+
+// ---------------------------------------------------------------- scalar
+
+inline block_hit scalar_intersect_block(const triangle_block& block, const ray& r, const float closest)
+{
+	auto best = block_hit{ -1, closest, 0.0f, 0.0f };
+	for (auto lane = 0; lane < packet_width; lane++)
+	{
+		const auto a = vec3(block.a_x[lane], block.a_y[lane], block.a_z[lane]);
+		const auto ab = vec3(block.ab_x[lane], block.ab_y[lane], block.ab_z[lane]);
+		const auto ac = vec3(block.ac_x[lane], block.ac_y[lane], block.ac_z[lane]);
+		const auto p = cross(r.direction, ac);
+		const auto determinant = dot(ab, p);
+		if (determinant > -determinant_epsilon && determinant < determinant_epsilon)
+		{
+			continue;
+		}
+		const auto inverse_determinant = 1.0f / determinant;
+		const auto s = r.origin - a;
+		const auto u = dot(s, p) * inverse_determinant;
+		const auto q = cross(s, ab);
+		const auto v = dot(r.direction, q) * inverse_determinant;
+		const auto distance = dot(ac, q) * inverse_determinant;
+		if (u >= 0.0f && v >= 0.0f && u + v <= 1.0f && distance > ray_epsilon && distance < best.distance)
+		{
+			best = block_hit{ lane, distance, u, v };
+		}
+	}
+	return best;
+}
+
+inline void scalar_intersect_packet_triangle(ray_packet& packet, const triangle& item, const int index)
+{
+	for (auto lane = 0; lane < packet_width; lane++)
+	{
+		const auto direction = vec3(packet.direction_x[lane], packet.direction_y[lane], packet.direction_z[lane]);
+		const auto p = cross(direction, item.edge_ac);
+		const auto determinant = dot(item.edge_ab, p);
+		if (determinant > -determinant_epsilon && determinant < determinant_epsilon)
+		{
+			continue;
+		}
+		const auto inverse_determinant = 1.0f / determinant;
+		const auto s = vec3(packet.origin_x[lane], packet.origin_y[lane], packet.origin_z[lane]) - item.a;
+		const auto u = dot(s, p) * inverse_determinant;
+		const auto q = cross(s, item.edge_ab);
+		const auto v = dot(direction, q) * inverse_determinant;
+		const auto distance = dot(item.edge_ac, q) * inverse_determinant;
+		if (u >= 0.0f && v >= 0.0f && u + v <= 1.0f && distance > ray_epsilon && distance < packet.distance[lane])
+		{
+			packet.distance[lane] = distance;
+			packet.u[lane] = u;
+			packet.v[lane] = v;
+			packet.triangle[lane] = index;
+		}
+	}
+}
+
+inline void scalar_intersect_packet_sphere(ray_packet& packet, const sphere_primitive& item, const int index)
+{
+	for (auto lane = 0; lane < packet_width; lane++)
+	{
+		const auto offset = vec3(packet.origin_x[lane], packet.origin_y[lane], packet.origin_z[lane]) - item.centre;
+		const auto direction = vec3(packet.direction_x[lane], packet.direction_y[lane], packet.direction_z[lane]);
+		const auto b = dot(offset, direction);
+		const auto c = dot(offset, offset) - item.radius * item.radius;
+		const auto discriminant = b * b - c;
+		if (discriminant < 0.0f)
+		{
+			continue;
+		}
+		const auto root = sqrt(discriminant);
+		const auto near_distance = -b - root;
+		const auto distance = near_distance > ray_epsilon ? near_distance : -b + root;
+		if (distance > ray_epsilon && distance < packet.distance[lane])
+		{
+			packet.distance[lane] = distance;
+			packet.sphere[lane] = index;
+			packet.triangle[lane] = -1;
+		}
+	}
+}
+
+inline bool scalar_intersect_packet_box(const ray_packet& packet, const bvh_node& node)
+{
+	for (auto lane = 0; lane < packet_width; lane++)
+	{
+		const auto origin = vec3(packet.origin_x[lane], packet.origin_y[lane], packet.origin_z[lane]);
+		const auto inverse = vec3(packet.inverse_x[lane], packet.inverse_y[lane], packet.inverse_z[lane]);
+		const auto near_planes = (node.minimum - origin) * inverse;
+		const auto far_planes = (node.maximum - origin) * inverse;
+		const auto entry = min(near_planes, far_planes);
+		const auto exit = max(near_planes, far_planes);
+		const auto t_entry = max(max(entry.x, entry.y), max(entry.z, 0.0f));
+		const auto t_exit = min(min(exit.x, exit.y), min(exit.z, packet.distance[lane]));
+		if (t_entry <= t_exit)
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+// ---------------------------------------------------------------- sse, two 4 wide halves
+
+inline __m128 sse_select(const __m128 mask, const __m128 when_true, const __m128 when_false)
+{
+	return _mm_or_ps(_mm_and_ps(mask, when_true), _mm_andnot_ps(mask, when_false));
+}
+
+inline block_hit sse_intersect_block(const triangle_block& block, const ray& r, const float closest)
+{
+	const auto origin_x = _mm_set1_ps(r.origin.x);
+	const auto origin_y = _mm_set1_ps(r.origin.y);
+	const auto origin_z = _mm_set1_ps(r.origin.z);
+	const auto direction_x = _mm_set1_ps(r.direction.x);
+	const auto direction_y = _mm_set1_ps(r.direction.y);
+	const auto direction_z = _mm_set1_ps(r.direction.z);
+	const auto epsilon = _mm_set1_ps(determinant_epsilon);
+	const auto zero = _mm_setzero_ps();
+	const auto one = _mm_set1_ps(1.0f);
+	alignas(16) float distances[packet_width];
+	alignas(16) float us[packet_width];
+	alignas(16) float vs[packet_width];
+	for (auto half = 0; half < packet_width; half += 4)
+	{
+		const auto ab_x = _mm_loadu_ps(block.ab_x + half);
+		const auto ab_y = _mm_loadu_ps(block.ab_y + half);
+		const auto ab_z = _mm_loadu_ps(block.ab_z + half);
+		const auto ac_x = _mm_loadu_ps(block.ac_x + half);
+		const auto ac_y = _mm_loadu_ps(block.ac_y + half);
+		const auto ac_z = _mm_loadu_ps(block.ac_z + half);
+		// p = d x ac
+		const auto p_x = _mm_sub_ps(_mm_mul_ps(direction_y, ac_z), _mm_mul_ps(direction_z, ac_y));
+		const auto p_y = _mm_sub_ps(_mm_mul_ps(direction_z, ac_x), _mm_mul_ps(direction_x, ac_z));
+		const auto p_z = _mm_sub_ps(_mm_mul_ps(direction_x, ac_y), _mm_mul_ps(direction_y, ac_x));
+		const auto determinant = _mm_add_ps(_mm_add_ps(_mm_mul_ps(ab_x, p_x), _mm_mul_ps(ab_y, p_y)), _mm_mul_ps(ab_z, p_z));
+		const auto absolute = _mm_max_ps(determinant, _mm_sub_ps(zero, determinant));
+		const auto inverse_determinant = _mm_div_ps(one, determinant);
+		const auto s_x = _mm_sub_ps(origin_x, _mm_loadu_ps(block.a_x + half));
+		const auto s_y = _mm_sub_ps(origin_y, _mm_loadu_ps(block.a_y + half));
+		const auto s_z = _mm_sub_ps(origin_z, _mm_loadu_ps(block.a_z + half));
+		const auto u = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(s_x, p_x), _mm_mul_ps(s_y, p_y)), _mm_mul_ps(s_z, p_z)), inverse_determinant);
+		// q = s x ab
+		const auto q_x = _mm_sub_ps(_mm_mul_ps(s_y, ab_z), _mm_mul_ps(s_z, ab_y));
+		const auto q_y = _mm_sub_ps(_mm_mul_ps(s_z, ab_x), _mm_mul_ps(s_x, ab_z));
+		const auto q_z = _mm_sub_ps(_mm_mul_ps(s_x, ab_y), _mm_mul_ps(s_y, ab_x));
+		const auto v = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(direction_x, q_x), _mm_mul_ps(direction_y, q_y)), _mm_mul_ps(direction_z, q_z)), inverse_determinant);
+		const auto distance = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(ac_x, q_x), _mm_mul_ps(ac_y, q_y)), _mm_mul_ps(ac_z, q_z)), inverse_determinant);
+		auto mask = _mm_cmpge_ps(absolute, epsilon);
+		mask = _mm_and_ps(mask, _mm_cmpge_ps(u, zero));
+		mask = _mm_and_ps(mask, _mm_cmpge_ps(v, zero));
+		mask = _mm_and_ps(mask, _mm_cmple_ps(_mm_add_ps(u, v), one));
+		mask = _mm_and_ps(mask, _mm_cmpgt_ps(distance, _mm_set1_ps(ray_epsilon)));
+		_mm_store_ps(distances + half, sse_select(mask, distance, _mm_set1_ps(FLT_MAX)));
+		_mm_store_ps(us + half, u);
+		_mm_store_ps(vs + half, v);
+	}
+	auto best = block_hit{ -1, closest, 0.0f, 0.0f };
+	for (auto lane = 0; lane < packet_width; lane++)
+	{
+		if (distances[lane] < best.distance)
+		{
+			best = block_hit{ lane, distances[lane], us[lane], vs[lane] };
+		}
+	}
+	return best;
+}
+
+inline void sse_intersect_packet_triangle(ray_packet& packet, const triangle& item, const int index)
+{
+	const auto a_x = _mm_set1_ps(item.a.x);
+	const auto a_y = _mm_set1_ps(item.a.y);
+	const auto a_z = _mm_set1_ps(item.a.z);
+	const auto ab_x = _mm_set1_ps(item.edge_ab.x);
+	const auto ab_y = _mm_set1_ps(item.edge_ab.y);
+	const auto ab_z = _mm_set1_ps(item.edge_ab.z);
+	const auto ac_x = _mm_set1_ps(item.edge_ac.x);
+	const auto ac_y = _mm_set1_ps(item.edge_ac.y);
+	const auto ac_z = _mm_set1_ps(item.edge_ac.z);
+	const auto epsilon = _mm_set1_ps(determinant_epsilon);
+	const auto zero = _mm_setzero_ps();
+	const auto one = _mm_set1_ps(1.0f);
+	const auto identifier = _mm_castsi128_ps(_mm_set1_epi32(index));
+	for (auto half = 0; half < packet_width; half += 4)
+	{
+		const auto direction_x = _mm_loadu_ps(packet.direction_x + half);
+		const auto direction_y = _mm_loadu_ps(packet.direction_y + half);
+		const auto direction_z = _mm_loadu_ps(packet.direction_z + half);
+		const auto p_x = _mm_sub_ps(_mm_mul_ps(direction_y, ac_z), _mm_mul_ps(direction_z, ac_y));
+		const auto p_y = _mm_sub_ps(_mm_mul_ps(direction_z, ac_x), _mm_mul_ps(direction_x, ac_z));
+		const auto p_z = _mm_sub_ps(_mm_mul_ps(direction_x, ac_y), _mm_mul_ps(direction_y, ac_x));
+		const auto determinant = _mm_add_ps(_mm_add_ps(_mm_mul_ps(ab_x, p_x), _mm_mul_ps(ab_y, p_y)), _mm_mul_ps(ab_z, p_z));
+		const auto absolute = _mm_max_ps(determinant, _mm_sub_ps(zero, determinant));
+		const auto inverse_determinant = _mm_div_ps(one, determinant);
+		const auto s_x = _mm_sub_ps(_mm_loadu_ps(packet.origin_x + half), a_x);
+		const auto s_y = _mm_sub_ps(_mm_loadu_ps(packet.origin_y + half), a_y);
+		const auto s_z = _mm_sub_ps(_mm_loadu_ps(packet.origin_z + half), a_z);
+		const auto u = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(s_x, p_x), _mm_mul_ps(s_y, p_y)), _mm_mul_ps(s_z, p_z)), inverse_determinant);
+		const auto q_x = _mm_sub_ps(_mm_mul_ps(s_y, ab_z), _mm_mul_ps(s_z, ab_y));
+		const auto q_y = _mm_sub_ps(_mm_mul_ps(s_z, ab_x), _mm_mul_ps(s_x, ab_z));
+		const auto q_z = _mm_sub_ps(_mm_mul_ps(s_x, ab_y), _mm_mul_ps(s_y, ab_x));
+		const auto v = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(direction_x, q_x), _mm_mul_ps(direction_y, q_y)), _mm_mul_ps(direction_z, q_z)), inverse_determinant);
+		const auto distance = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(ac_x, q_x), _mm_mul_ps(ac_y, q_y)), _mm_mul_ps(ac_z, q_z)), inverse_determinant);
+		const auto closest = _mm_loadu_ps(packet.distance + half);
+		auto mask = _mm_cmpge_ps(absolute, epsilon);
+		mask = _mm_and_ps(mask, _mm_cmpge_ps(u, zero));
+		mask = _mm_and_ps(mask, _mm_cmpge_ps(v, zero));
+		mask = _mm_and_ps(mask, _mm_cmple_ps(_mm_add_ps(u, v), one));
+		mask = _mm_and_ps(mask, _mm_cmpgt_ps(distance, _mm_set1_ps(ray_epsilon)));
+		mask = _mm_and_ps(mask, _mm_cmplt_ps(distance, closest));
+		if (_mm_movemask_ps(mask) == 0)
+		{
+			continue;
+		}
+		_mm_storeu_ps(packet.distance + half, sse_select(mask, distance, closest));
+		_mm_storeu_ps(packet.u + half, sse_select(mask, u, _mm_loadu_ps(packet.u + half)));
+		_mm_storeu_ps(packet.v + half, sse_select(mask, v, _mm_loadu_ps(packet.v + half)));
+		const auto triangles = reinterpret_cast<float*>(packet.triangle + half);
+		_mm_storeu_ps(triangles, sse_select(mask, identifier, _mm_loadu_ps(triangles)));
+	}
+}
+
+inline void sse_intersect_packet_sphere(ray_packet& packet, const sphere_primitive& item, const int index)
+{
+	const auto centre_x = _mm_set1_ps(item.centre.x);
+	const auto centre_y = _mm_set1_ps(item.centre.y);
+	const auto centre_z = _mm_set1_ps(item.centre.z);
+	const auto radius_squared = _mm_set1_ps(item.radius * item.radius);
+	const auto epsilon = _mm_set1_ps(ray_epsilon);
+	const auto zero = _mm_setzero_ps();
+	const auto identifier = _mm_castsi128_ps(_mm_set1_epi32(index));
+	const auto no_triangle = _mm_castsi128_ps(_mm_set1_epi32(-1));
+	for (auto half = 0; half < packet_width; half += 4)
+	{
+		const auto offset_x = _mm_sub_ps(_mm_loadu_ps(packet.origin_x + half), centre_x);
+		const auto offset_y = _mm_sub_ps(_mm_loadu_ps(packet.origin_y + half), centre_y);
+		const auto offset_z = _mm_sub_ps(_mm_loadu_ps(packet.origin_z + half), centre_z);
+		const auto b = _mm_add_ps(_mm_add_ps(
+			_mm_mul_ps(offset_x, _mm_loadu_ps(packet.direction_x + half)),
+			_mm_mul_ps(offset_y, _mm_loadu_ps(packet.direction_y + half))),
+			_mm_mul_ps(offset_z, _mm_loadu_ps(packet.direction_z + half)));
+		const auto c = _mm_sub_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(offset_x, offset_x), _mm_mul_ps(offset_y, offset_y)), _mm_mul_ps(offset_z, offset_z)), radius_squared);
+		const auto discriminant = _mm_sub_ps(_mm_mul_ps(b, b), c);
+		auto mask = _mm_cmpge_ps(discriminant, zero);
+		if (_mm_movemask_ps(mask) == 0)
+		{
+			continue;
+		}
+		const auto root = _mm_sqrt_ps(_mm_max_ps(discriminant, zero));
+		const auto near_distance = _mm_sub_ps(_mm_sub_ps(zero, b), root);
+		const auto far_distance = _mm_add_ps(_mm_sub_ps(zero, b), root);
+		const auto distance = sse_select(_mm_cmpgt_ps(near_distance, epsilon), near_distance, far_distance);
+		const auto closest = _mm_loadu_ps(packet.distance + half);
+		mask = _mm_and_ps(mask, _mm_cmpgt_ps(distance, epsilon));
+		mask = _mm_and_ps(mask, _mm_cmplt_ps(distance, closest));
+		if (_mm_movemask_ps(mask) == 0)
+		{
+			continue;
+		}
+		_mm_storeu_ps(packet.distance + half, sse_select(mask, distance, closest));
+		const auto spheres = reinterpret_cast<float*>(packet.sphere + half);
+		_mm_storeu_ps(spheres, sse_select(mask, identifier, _mm_loadu_ps(spheres)));
+		const auto triangles = reinterpret_cast<float*>(packet.triangle + half);
+		_mm_storeu_ps(triangles, sse_select(mask, no_triangle, _mm_loadu_ps(triangles)));
+	}
+}
+
+inline bool sse_intersect_packet_box(const ray_packet& packet, const bvh_node& node)
+{
+	const auto minimum_x = _mm_set1_ps(node.minimum.x);
+	const auto minimum_y = _mm_set1_ps(node.minimum.y);
+	const auto minimum_z = _mm_set1_ps(node.minimum.z);
+	const auto maximum_x = _mm_set1_ps(node.maximum.x);
+	const auto maximum_y = _mm_set1_ps(node.maximum.y);
+	const auto maximum_z = _mm_set1_ps(node.maximum.z);
+	for (auto half = 0; half < packet_width; half += 4)
+	{
+		const auto origin_x = _mm_loadu_ps(packet.origin_x + half);
+		const auto origin_y = _mm_loadu_ps(packet.origin_y + half);
+		const auto origin_z = _mm_loadu_ps(packet.origin_z + half);
+		const auto inverse_x = _mm_loadu_ps(packet.inverse_x + half);
+		const auto inverse_y = _mm_loadu_ps(packet.inverse_y + half);
+		const auto inverse_z = _mm_loadu_ps(packet.inverse_z + half);
+		const auto near_x = _mm_mul_ps(_mm_sub_ps(minimum_x, origin_x), inverse_x);
+		const auto near_y = _mm_mul_ps(_mm_sub_ps(minimum_y, origin_y), inverse_y);
+		const auto near_z = _mm_mul_ps(_mm_sub_ps(minimum_z, origin_z), inverse_z);
+		const auto far_x = _mm_mul_ps(_mm_sub_ps(maximum_x, origin_x), inverse_x);
+		const auto far_y = _mm_mul_ps(_mm_sub_ps(maximum_y, origin_y), inverse_y);
+		const auto far_z = _mm_mul_ps(_mm_sub_ps(maximum_z, origin_z), inverse_z);
+		const auto entry = _mm_max_ps(_mm_max_ps(_mm_min_ps(near_x, far_x), _mm_min_ps(near_y, far_y)), _mm_max_ps(_mm_min_ps(near_z, far_z), _mm_setzero_ps()));
+		const auto exit = _mm_min_ps(_mm_min_ps(_mm_max_ps(near_x, far_x), _mm_max_ps(near_y, far_y)), _mm_min_ps(_mm_max_ps(near_z, far_z), _mm_loadu_ps(packet.distance + half)));
+		if (_mm_movemask_ps(_mm_cmple_ps(entry, exit)) != 0)
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+// ---------------------------------------------------------------- avx2, all 8 lanes at once
+
+SIMD_AVX2 inline block_hit avx2_intersect_block(const triangle_block& block, const ray& r, const float closest)
+{
+	const auto direction_x = _mm256_set1_ps(r.direction.x);
+	const auto direction_y = _mm256_set1_ps(r.direction.y);
+	const auto direction_z = _mm256_set1_ps(r.direction.z);
+	const auto zero = _mm256_setzero_ps();
+	const auto one = _mm256_set1_ps(1.0f);
+	const auto ab_x = _mm256_loadu_ps(block.ab_x);
+	const auto ab_y = _mm256_loadu_ps(block.ab_y);
+	const auto ab_z = _mm256_loadu_ps(block.ab_z);
+	const auto ac_x = _mm256_loadu_ps(block.ac_x);
+	const auto ac_y = _mm256_loadu_ps(block.ac_y);
+	const auto ac_z = _mm256_loadu_ps(block.ac_z);
+	const auto p_x = _mm256_sub_ps(_mm256_mul_ps(direction_y, ac_z), _mm256_mul_ps(direction_z, ac_y));
+	const auto p_y = _mm256_sub_ps(_mm256_mul_ps(direction_z, ac_x), _mm256_mul_ps(direction_x, ac_z));
+	const auto p_z = _mm256_sub_ps(_mm256_mul_ps(direction_x, ac_y), _mm256_mul_ps(direction_y, ac_x));
+	const auto determinant = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(ab_x, p_x), _mm256_mul_ps(ab_y, p_y)), _mm256_mul_ps(ab_z, p_z));
+	const auto absolute = _mm256_max_ps(determinant, _mm256_sub_ps(zero, determinant));
+	const auto inverse_determinant = _mm256_div_ps(one, determinant);
+	const auto s_x = _mm256_sub_ps(_mm256_set1_ps(r.origin.x), _mm256_loadu_ps(block.a_x));
+	const auto s_y = _mm256_sub_ps(_mm256_set1_ps(r.origin.y), _mm256_loadu_ps(block.a_y));
+	const auto s_z = _mm256_sub_ps(_mm256_set1_ps(r.origin.z), _mm256_loadu_ps(block.a_z));
+	const auto u = _mm256_mul_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(s_x, p_x), _mm256_mul_ps(s_y, p_y)), _mm256_mul_ps(s_z, p_z)), inverse_determinant);
+	const auto q_x = _mm256_sub_ps(_mm256_mul_ps(s_y, ab_z), _mm256_mul_ps(s_z, ab_y));
+	const auto q_y = _mm256_sub_ps(_mm256_mul_ps(s_z, ab_x), _mm256_mul_ps(s_x, ab_z));
+	const auto q_z = _mm256_sub_ps(_mm256_mul_ps(s_x, ab_y), _mm256_mul_ps(s_y, ab_x));
+	const auto v = _mm256_mul_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(direction_x, q_x), _mm256_mul_ps(direction_y, q_y)), _mm256_mul_ps(direction_z, q_z)), inverse_determinant);
+	const auto distance = _mm256_mul_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(ac_x, q_x), _mm256_mul_ps(ac_y, q_y)), _mm256_mul_ps(ac_z, q_z)), inverse_determinant);
+	auto mask = _mm256_cmp_ps(absolute, _mm256_set1_ps(determinant_epsilon), _CMP_GE_OQ);
+	mask = _mm256_and_ps(mask, _mm256_cmp_ps(u, zero, _CMP_GE_OQ));
+	mask = _mm256_and_ps(mask, _mm256_cmp_ps(v, zero, _CMP_GE_OQ));
+	mask = _mm256_and_ps(mask, _mm256_cmp_ps(_mm256_add_ps(u, v), one, _CMP_LE_OQ));
+	mask = _mm256_and_ps(mask, _mm256_cmp_ps(distance, _mm256_set1_ps(ray_epsilon), _CMP_GT_OQ));
+	mask = _mm256_and_ps(mask, _mm256_cmp_ps(distance, _mm256_set1_ps(closest), _CMP_LT_OQ));
+	auto best = block_hit{ -1, closest, 0.0f, 0.0f };
+	auto bits = _mm256_movemask_ps(mask);
+	if (bits == 0)
+	{
+		return best;
+	}
+	alignas(32) float distances[packet_width];
+	alignas(32) float us[packet_width];
+	alignas(32) float vs[packet_width];
+	_mm256_store_ps(distances, distance);
+	_mm256_store_ps(us, u);
+	_mm256_store_ps(vs, v);
+	for (auto lane = 0; bits != 0; lane++, bits >>= 1)
+	{
+		if ((bits & 1) != 0 && distances[lane] < best.distance)
+		{
+			best = block_hit{ lane, distances[lane], us[lane], vs[lane] };
+		}
+	}
+	return best;
+}
+
+SIMD_AVX2 inline void avx2_intersect_packet_triangle(ray_packet& packet, const triangle& item, const int index)
+{
+	const auto zero = _mm256_setzero_ps();
+	const auto one = _mm256_set1_ps(1.0f);
+	const auto ab_x = _mm256_set1_ps(item.edge_ab.x);
+	const auto ab_y = _mm256_set1_ps(item.edge_ab.y);
+	const auto ab_z = _mm256_set1_ps(item.edge_ab.z);
+	const auto ac_x = _mm256_set1_ps(item.edge_ac.x);
+	const auto ac_y = _mm256_set1_ps(item.edge_ac.y);
+	const auto ac_z = _mm256_set1_ps(item.edge_ac.z);
+	const auto direction_x = _mm256_loadu_ps(packet.direction_x);
+	const auto direction_y = _mm256_loadu_ps(packet.direction_y);
+	const auto direction_z = _mm256_loadu_ps(packet.direction_z);
+	const auto p_x = _mm256_sub_ps(_mm256_mul_ps(direction_y, ac_z), _mm256_mul_ps(direction_z, ac_y));
+	const auto p_y = _mm256_sub_ps(_mm256_mul_ps(direction_z, ac_x), _mm256_mul_ps(direction_x, ac_z));
+	const auto p_z = _mm256_sub_ps(_mm256_mul_ps(direction_x, ac_y), _mm256_mul_ps(direction_y, ac_x));
+	const auto determinant = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(ab_x, p_x), _mm256_mul_ps(ab_y, p_y)), _mm256_mul_ps(ab_z, p_z));
+	const auto absolute = _mm256_max_ps(determinant, _mm256_sub_ps(zero, determinant));
+	const auto inverse_determinant = _mm256_div_ps(one, determinant);
+	const auto s_x = _mm256_sub_ps(_mm256_loadu_ps(packet.origin_x), _mm256_set1_ps(item.a.x));
+	const auto s_y = _mm256_sub_ps(_mm256_loadu_ps(packet.origin_y), _mm256_set1_ps(item.a.y));
+	const auto s_z = _mm256_sub_ps(_mm256_loadu_ps(packet.origin_z), _mm256_set1_ps(item.a.z));
+	const auto u = _mm256_mul_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(s_x, p_x), _mm256_mul_ps(s_y, p_y)), _mm256_mul_ps(s_z, p_z)), inverse_determinant);
+	const auto q_x = _mm256_sub_ps(_mm256_mul_ps(s_y, ab_z), _mm256_mul_ps(s_z, ab_y));
+	const auto q_y = _mm256_sub_ps(_mm256_mul_ps(s_z, ab_x), _mm256_mul_ps(s_x, ab_z));
+	const auto q_z = _mm256_sub_ps(_mm256_mul_ps(s_x, ab_y), _mm256_mul_ps(s_y, ab_x));
+	const auto v = _mm256_mul_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(direction_x, q_x), _mm256_mul_ps(direction_y, q_y)), _mm256_mul_ps(direction_z, q_z)), inverse_determinant);
+	const auto distance = _mm256_mul_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(ac_x, q_x), _mm256_mul_ps(ac_y, q_y)), _mm256_mul_ps(ac_z, q_z)), inverse_determinant);
+	const auto closest = _mm256_loadu_ps(packet.distance);
+	auto mask = _mm256_cmp_ps(absolute, _mm256_set1_ps(determinant_epsilon), _CMP_GE_OQ);
+	mask = _mm256_and_ps(mask, _mm256_cmp_ps(u, zero, _CMP_GE_OQ));
+	mask = _mm256_and_ps(mask, _mm256_cmp_ps(v, zero, _CMP_GE_OQ));
+	mask = _mm256_and_ps(mask, _mm256_cmp_ps(_mm256_add_ps(u, v), one, _CMP_LE_OQ));
+	mask = _mm256_and_ps(mask, _mm256_cmp_ps(distance, _mm256_set1_ps(ray_epsilon), _CMP_GT_OQ));
+	mask = _mm256_and_ps(mask, _mm256_cmp_ps(distance, closest, _CMP_LT_OQ));
+	if (_mm256_movemask_ps(mask) == 0)
+	{
+		return;
+	}
+	_mm256_storeu_ps(packet.distance, _mm256_blendv_ps(closest, distance, mask));
+	_mm256_storeu_ps(packet.u, _mm256_blendv_ps(_mm256_loadu_ps(packet.u), u, mask));
+	_mm256_storeu_ps(packet.v, _mm256_blendv_ps(_mm256_loadu_ps(packet.v), v, mask));
+	const auto triangles = reinterpret_cast<float*>(packet.triangle);
+	_mm256_storeu_ps(triangles, _mm256_blendv_ps(_mm256_loadu_ps(triangles), _mm256_castsi256_ps(_mm256_set1_epi32(index)), mask));
+}
+
+SIMD_AVX2 inline void avx2_intersect_packet_sphere(ray_packet& packet, const sphere_primitive& item, const int index)
+{
+	const auto zero = _mm256_setzero_ps();
+	const auto epsilon = _mm256_set1_ps(ray_epsilon);
+	const auto offset_x = _mm256_sub_ps(_mm256_loadu_ps(packet.origin_x), _mm256_set1_ps(item.centre.x));
+	const auto offset_y = _mm256_sub_ps(_mm256_loadu_ps(packet.origin_y), _mm256_set1_ps(item.centre.y));
+	const auto offset_z = _mm256_sub_ps(_mm256_loadu_ps(packet.origin_z), _mm256_set1_ps(item.centre.z));
+	const auto b = _mm256_add_ps(_mm256_add_ps(
+		_mm256_mul_ps(offset_x, _mm256_loadu_ps(packet.direction_x)),
+		_mm256_mul_ps(offset_y, _mm256_loadu_ps(packet.direction_y))),
+		_mm256_mul_ps(offset_z, _mm256_loadu_ps(packet.direction_z)));
+	const auto c = _mm256_sub_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(offset_x, offset_x), _mm256_mul_ps(offset_y, offset_y)), _mm256_mul_ps(offset_z, offset_z)), _mm256_set1_ps(item.radius * item.radius));
+	const auto discriminant = _mm256_sub_ps(_mm256_mul_ps(b, b), c);
+	auto mask = _mm256_cmp_ps(discriminant, zero, _CMP_GE_OQ);
+	if (_mm256_movemask_ps(mask) == 0)
+	{
+		return;
+	}
+	const auto root = _mm256_sqrt_ps(_mm256_max_ps(discriminant, zero));
+	const auto near_distance = _mm256_sub_ps(_mm256_sub_ps(zero, b), root);
+	const auto far_distance = _mm256_add_ps(_mm256_sub_ps(zero, b), root);
+	const auto distance = _mm256_blendv_ps(far_distance, near_distance, _mm256_cmp_ps(near_distance, epsilon, _CMP_GT_OQ));
+	const auto closest = _mm256_loadu_ps(packet.distance);
+	mask = _mm256_and_ps(mask, _mm256_cmp_ps(distance, epsilon, _CMP_GT_OQ));
+	mask = _mm256_and_ps(mask, _mm256_cmp_ps(distance, closest, _CMP_LT_OQ));
+	if (_mm256_movemask_ps(mask) == 0)
+	{
+		return;
+	}
+	_mm256_storeu_ps(packet.distance, _mm256_blendv_ps(closest, distance, mask));
+	const auto spheres = reinterpret_cast<float*>(packet.sphere);
+	_mm256_storeu_ps(spheres, _mm256_blendv_ps(_mm256_loadu_ps(spheres), _mm256_castsi256_ps(_mm256_set1_epi32(index)), mask));
+	const auto triangles = reinterpret_cast<float*>(packet.triangle);
+	_mm256_storeu_ps(triangles, _mm256_blendv_ps(_mm256_loadu_ps(triangles), _mm256_castsi256_ps(_mm256_set1_epi32(-1)), mask));
+}
+
+SIMD_AVX2 inline bool avx2_intersect_packet_box(const ray_packet& packet, const bvh_node& node)
+{
+	const auto origin_x = _mm256_loadu_ps(packet.origin_x);
+	const auto origin_y = _mm256_loadu_ps(packet.origin_y);
+	const auto origin_z = _mm256_loadu_ps(packet.origin_z);
+	const auto inverse_x = _mm256_loadu_ps(packet.inverse_x);
+	const auto inverse_y = _mm256_loadu_ps(packet.inverse_y);
+	const auto inverse_z = _mm256_loadu_ps(packet.inverse_z);
+	const auto near_x = _mm256_mul_ps(_mm256_sub_ps(_mm256_set1_ps(node.minimum.x), origin_x), inverse_x);
+	const auto near_y = _mm256_mul_ps(_mm256_sub_ps(_mm256_set1_ps(node.minimum.y), origin_y), inverse_y);
+	const auto near_z = _mm256_mul_ps(_mm256_sub_ps(_mm256_set1_ps(node.minimum.z), origin_z), inverse_z);
+	const auto far_x = _mm256_mul_ps(_mm256_sub_ps(_mm256_set1_ps(node.maximum.x), origin_x), inverse_x);
+	const auto far_y = _mm256_mul_ps(_mm256_sub_ps(_mm256_set1_ps(node.maximum.y), origin_y), inverse_y);
+	const auto far_z = _mm256_mul_ps(_mm256_sub_ps(_mm256_set1_ps(node.maximum.z), origin_z), inverse_z);
+	const auto entry = _mm256_max_ps(_mm256_max_ps(_mm256_min_ps(near_x, far_x), _mm256_min_ps(near_y, far_y)), _mm256_max_ps(_mm256_min_ps(near_z, far_z), _mm256_setzero_ps()));
+	const auto exit = _mm256_min_ps(_mm256_min_ps(_mm256_max_ps(near_x, far_x), _mm256_max_ps(near_y, far_y)), _mm256_min_ps(_mm256_max_ps(near_z, far_z), _mm256_loadu_ps(packet.distance)));
+	return _mm256_movemask_ps(_mm256_cmp_ps(entry, exit, _CMP_LE_OQ)) != 0;
+}
+
+// ---------------------------------------------------------------- dispatch
+
+inline simd_kernels make_kernels(const simd_level level)
+{
+	switch (level)
+	{
+	case simd_level::avx2:
+		return { level, avx2_intersect_block, avx2_intersect_packet_triangle, avx2_intersect_packet_sphere, avx2_intersect_packet_box };
+	case simd_level::sse:
+		return { level, sse_intersect_block, sse_intersect_packet_triangle, sse_intersect_packet_sphere, sse_intersect_packet_box };
+	default:
+		return { level, scalar_intersect_block, scalar_intersect_packet_triangle, scalar_intersect_packet_sphere, scalar_intersect_packet_box };
+	}
+}
+
+// the table every renderer reads from, selected from CPUID on first use
+inline simd_kernels& active_kernels()
+{
+	static auto kernels = make_kernels(detect_simd());
+	return kernels;
+}
+
+// forcing a narrower level is only meant for benchmarks and comparisons, never a wider one than the CPU has
+inline void select_simd(const simd_level level)
+{
+	active_kernels() = make_kernels(int(level) <= int(detect_simd()) ? level : detect_simd());
+}
+#endif
@@ -0,0 +1,310 @@
+// TCP connections over BSD sockets or Winsock. send() and receive() move the whole buffer or fail, so callers using them deal
+// in complete messages and a short read or write means the other side has gone, or with a send timeout set, stopped reading.
+// receive_available() instead returns whatever has arrived, for callers that poll several connections and put messages
+// back together themselves.
+#ifndef SOCKET_H
+#define SOCKET_H
+
+#include <algorithm>
+#include <cstddef>
+#include <string>
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#pragma comment(lib, "Ws2_32.lib")
+typedef SOCKET socket_handle;
+typedef WSAPOLLFD socket_poll;
+const socket_handle no_socket = INVALID_SOCKET;
+#else
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+typedef int socket_handle;
+typedef pollfd socket_poll;
+const socket_handle no_socket = -1;
+#endif
+
+// writing to a connection the other side closed must fail instead of raising SIGPIPE
+#if defined(MSG_NOSIGNAL)
+const int socket_send_flags = MSG_NOSIGNAL;
+#else
+const int socket_send_flags = 0;
+#endif
+
+// Winsock has to be started once before the first socket call
+inline bool start_sockets()
+{
+#if defined(_WIN32)
+	static const auto started = []()
+	{
+		WSADATA data;
+		return WSAStartup(MAKEWORD(2, 2), &data) == 0;
+	}();
+	return started;
+#else
+	return true;
+#endif
+}
+
+inline void close_socket(const socket_handle handle)
+{
+#if defined(_WIN32)
+	closesocket(handle);
+#else
+	::close(handle);
+#endif
+}
+
+// waits up to timeout milliseconds for one of the count sockets to have data or to be closed; false on error
+inline bool poll_sockets(socket_poll* sockets, const size_t count, const int timeout)
+{
+#if defined(_WIN32)
+	return WSAPoll(sockets, ULONG(count), timeout) >= 0;
+#else
+	return poll(sockets, nfds_t(count), timeout) >= 0;
+#endif
+}
+
+class connection
+{
+	socket_handle handle_;
+
+	// small messages go out as soon as they are written instead of waiting to fill a packet
+	void configure() const
+	{
+		const int on = 1;
+		setsockopt(this->handle_, IPPROTO_TCP, TCP_NODELAY, reinterpret_cast<const char*>(&on), sizeof(on));
+#if defined(SO_NOSIGPIPE)
+		setsockopt(this->handle_, SOL_SOCKET, SO_NOSIGPIPE, &on, sizeof(on));
+#endif
+	}
+
+public:
+	connection() : handle_(no_socket) {}
+
+	connection(const connection&) = delete;
+	connection& operator=(const connection&) = delete;
+
+	// false when nobody accepts at host:port
+	bool open(const char* host, const int port)
+	{
+		this->close();
+		if (!start_sockets())
+		{
+			return false;
+		}
+		addrinfo hints = {};
+		hints.ai_family = AF_UNSPEC;
+		hints.ai_socktype = SOCK_STREAM;
+		addrinfo* found = nullptr;
+		if (getaddrinfo(host, std::to_string(port).c_str(), &hints, &found) != 0)
+		{
+			return false;
+		}
+		for (auto address = found; address != nullptr && this->handle_ == no_socket; address = address->ai_next)
+		{
+			const auto handle = socket(address->ai_family, address->ai_socktype, address->ai_protocol);
+			if (handle == no_socket)
+			{
+				continue;
+			}
+			if (connect(handle, address->ai_addr, int(address->ai_addrlen)) == 0)
+			{
+				this->handle_ = handle;
+			}
+			else
+			{
+				close_socket(handle);
+			}
+		}
+		freeaddrinfo(found);
+		if (this->handle_ == no_socket)
+		{
+			return false;
+		}
+		this->configure();
+		return true;
+	}
+
+	// takes over a socket a listener accepted
+	void adopt(const socket_handle handle)
+	{
+		this->close();
+		this->handle_ = handle;
+		this->configure();
+	}
+
+	bool is_open() const
+	{
+		return this->handle_ != no_socket;
+	}
+
+	socket_handle get_handle() const
+	{
+		return this->handle_;
+	}
+
+	// a send that makes no progress for timeout milliseconds fails instead of waiting for a peer that stopped reading
+	void set_send_timeout(const int timeout) const
+	{
+#if defined(_WIN32)
+		const DWORD limit = DWORD(timeout);
+		setsockopt(this->handle_, SOL_SOCKET, SO_SNDTIMEO, reinterpret_cast<const char*>(&limit), sizeof(limit));
+#else
+		timeval limit = {};
+		limit.tv_sec = timeout / 1000;
+		limit.tv_usec = (timeout % 1000) * 1000;
+		setsockopt(this->handle_, SOL_SOCKET, SO_SNDTIMEO, &limit, sizeof(limit));
+#endif
+	}
+
+	// waits up to timeout milliseconds for something to receive; also true once the other side has gone, which the next
+	// receive reports
+	bool wait(const int timeout) const
+	{
+		auto entry = socket_poll();
+		entry.fd = this->handle_;
+		entry.events = POLLIN;
+		return poll_sockets(&entry, 1, timeout) && entry.revents != 0;
+	}
+
+	bool send(const void* data, size_t size)
+	{
+		auto bytes = static_cast<const char*>(data);
+		while (size > 0)
+		{
+			const auto sent = ::send(this->handle_, bytes, int(std::min(size, size_t(1) << 30)), socket_send_flags);
+			if (sent <= 0)
+			{
+				return false;
+			}
+			bytes += sent;
+			size -= size_t(sent);
+		}
+		return true;
+	}
+
+	// whatever has arrived, up to size bytes, into data; blocks only when nothing has, so callers poll first. False once the
+	// other side has gone
+	bool receive_available(void* data, const size_t size, size_t& received)
+	{
+		const auto count = recv(this->handle_, static_cast<char*>(data), int(std::min(size, size_t(1) << 30)), 0);
+		if (count <= 0)
+		{
+			return false;
+		}
+		received = size_t(count);
+		return true;
+	}
+
+	// blocks until size bytes have arrived
+	bool receive(void* data, size_t size)
+	{
+		auto bytes = static_cast<char*>(data);
+		while (size > 0)
+		{
+			const auto received = recv(this->handle_, bytes, int(std::min(size, size_t(1) << 30)), 0);
+			if (received <= 0)
+			{
+				return false;
+			}
+			bytes += received;
+			size -= size_t(received);
+		}
+		return true;
+	}
+
+	void close()
+	{
+		if (this->handle_ != no_socket)
+		{
+			close_socket(this->handle_);
+		}
+		this->handle_ = no_socket;
+	}
+
+	~connection()
+	{
+		this->close();
+	}
+};
+
+class listener
+{
+	socket_handle handle_;
+
+public:
+	listener() : handle_(no_socket) {}
+
+	listener(const listener&) = delete;
+	listener& operator=(const listener&) = delete;
+
+	// listens on port on every interface; false when the port is taken
+	bool open(const int port)
+	{
+		if (!start_sockets())
+		{
+			return false;
+		}
+		this->handle_ = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+		if (this->handle_ == no_socket)
+		{
+			return false;
+		}
+#if !defined(_WIN32)
+		// a coordinator started again right away should not have to wait for the last run's connections to time out
+		const int on = 1;
+		setsockopt(this->handle_, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+#endif
+		sockaddr_in address = {};
+		address.sin_family = AF_INET;
+		address.sin_addr.s_addr = htonl(INADDR_ANY);
+		address.sin_port = htons(static_cast<unsigned short>(port));
+		if (bind(this->handle_, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0 || listen(this->handle_, SOMAXCONN) != 0)
+		{
+			this->close();
+			return false;
+		}
+		return true;
+	}
+
+	// waits up to timeout milliseconds for someone to connect; false when nobody does
+	bool accept(connection& accepted, const int timeout)
+	{
+		auto entry = socket_poll();
+		entry.fd = this->handle_;
+		entry.events = POLLIN;
+		if (!poll_sockets(&entry, 1, timeout) || (entry.revents & POLLIN) == 0)
+		{
+			return false;
+		}
+		const auto handle = ::accept(this->handle_, nullptr, nullptr);
+		if (handle == no_socket)
+		{
+			return false;
+		}
+		accepted.adopt(handle);
+		return true;
+	}
+
+	void close()
+	{
+		if (this->handle_ != no_socket)
+		{
+			close_socket(this->handle_);
+		}
+		this->handle_ = no_socket;
+	}
+
+	~listener()
+	{
+		this->close();
+	}
+};
+#endif
@@ -1,11 +1,58 @@
-struct point
-{
-	float x;
-	float y;
-	float z;
-	point(): x(0), y(0), z(0)
-	{
-	}
-
-	point(const float x, const float y, const float z) : x(x), y(y), z(z) {}
-};
\ No newline at end of file
+#ifndef STRUCTS_H
+#define STRUCTS_H
+
+#include <cstddef>
+
+struct point
+{
+	float x;
+	float y;
+	float z;
+	point(): x(0), y(0), z(0)
+	{
+	}
+
+	point(const float x, const float y, const float z) : x(x), y(y), z(z) {}
+};
+
+// read only window onto elements owned elsewhere, e.g. a vector or a memory mapped file
+template <typename element>
+struct array_view
+{
+	const element* items;
+	size_t count;
+
+	array_view() : items(nullptr), count(0) {}
+	array_view(const element* items, const size_t count) : items(items), count(count) {}
+
+	size_t size() const
+	{
+		return this->count;
+	}
+
+	bool empty() const
+	{
+		return this->count == 0;
+	}
+
+	const element* data() const
+	{
+		return this->items;
+	}
+
+	const element* begin() const
+	{
+		return this->items;
+	}
+
+	const element* end() const
+	{
+		return this->items + this->count;
+	}
+
+	const element& operator[](const size_t index) const
+	{
+		return this->items[index];
+	}
+};
+#endif
\ No newline at end of file
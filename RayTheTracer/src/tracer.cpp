@@ -0,0 +1,1032 @@
+// CPU ray tracer: primary rays from the camera through the projection plane, shaded with the same phong model as fragment_shader.fsh
+// and mixed with reflected and refracted rays in the proportions the material's coefficients give.
+// Primary rays travel in packets of 8 neighbouring pixels, every other ray goes through trace() one at a time. The wavefront
+// mode instead keeps every ray of a tile in queues and takes them through intersection, shading and shadow tests a depth at a time.
+#ifndef TRACER_H
+#define TRACER_H
+
+#include <../src/scene.cpp>
+#include <../src/ray.cpp>
+#include <../src/simd.cpp>
+#include <../src/instances.cpp>
+#include <../src/image.cpp>
+#include <../src/scheduler.cpp>
+#include <../src/ray_queue.cpp>
+#include <../src/arena.cpp>
+#include <algorithm>
+#include <functional>
+#include <map>
+#include <memory>
+#include <vector>
+
+// every refracting material is treated as glass
+const float glass_index = 1.5f;
+
+// how far secondary rays are followed
+struct trace_limits
+{
+	// bounces after the primary hit, 0 gives plain phong shading
+	int max_depth;
+	// branches whose weight in the pixel falls below this are not traced
+	float min_contribution;
+	// from this depth on, paths weighing less than roulette_weight survive with probability weight / roulette_weight
+	int roulette_depth;
+	float roulette_weight;
+
+	trace_limits() : max_depth(4), min_contribution(0.01f), roulette_depth(2), roulette_weight(0.1f) {}
+};
+
+// how many samples adaptive rendering may spend on a pixel
+struct sampling_limits
+{
+	// taken by every pixel before its variance is looked at
+	int min_samples;
+	int max_samples;
+	// added to pixels that have not settled yet, per round
+	int batch;
+	// standard error of the pixel's mean, relative to its brightness, at which it counts as settled
+	float threshold;
+
+	sampling_limits() : min_samples(4), max_samples(64), batch(4), threshold(0.02f) {}
+};
+
+// bounces taken so far, how much the path's radiance still counts for in the pixel, and its random state
+struct path_state
+{
+	int depth;
+	vec3 weight;
+	unsigned seed;
+};
+
+// phong terms of a hit, kept apart so the shadow test can be made later; diffuse and specular only count when nothing
+// lies between shadow_origin and the light
+struct surface_light
+{
+	vec3 ambient;
+	vec3 diffuse;
+	vec3 specular;
+	// false when the surface faces away from the light and there is nothing to test
+	bool faces_light;
+	vec3 shadow_origin;
+	vec3 light_direction;
+	float light_distance;
+};
+
+// a reflected or refracted ray leaving a hit and the share of the surface's light it carries
+struct bounce
+{
+	float amount;
+	vec3 origin;
+	vec3 direction;
+};
+
+// what one worker of the wavefront renderer reuses from tile to tile
+struct wavefront_state
+{
+	ray_queue current;
+	ray_queue next;
+	shadow_queue shadows;
+	// the closest hit of each ray in current, with a null surface for misses
+	std::vector<intersection> hits;
+	// indices of the rays that hit something, grouped by material
+	std::vector<int> order;
+	// the tile's pixels, in the worker's frame arena
+	vec3* sums;
+
+	wavefront_state() : sums(nullptr) {}
+};
+
+// what a render worker keeps from frame to frame: an arena for the buffers of the tile in hand, reset at the start of every
+// tile, and the wavefront queues, which keep their capacity
+struct worker_memory
+{
+	arena frame;
+	wavefront_state wavefront;
+	// taken by adaptive rendering in the current frame
+	size_t samples;
+
+	worker_memory() : samples(0) {}
+};
+
+class tracer
+{
+	// one bottom level hierarchy per unique mesh, shared by every instance of it
+	std::map<const mesh*, std::unique_ptr<mesh_bvh>> meshes_;
+	// the top level, in the order of its leaves
+	std::vector<instance> instances_;
+	bvh instance_tree_;
+	// round spheres skip tessellation and get their own hierarchy
+	std::vector<sphere_primitive> spheres_;
+	// the shape behind each of spheres_, in the same order
+	std::vector<const sphere*> sphere_sources_;
+	bvh sphere_tree_;
+	const camera* camera_;
+	const wall* projection_plane_;
+	const light* light_;
+	trace_limits limits_;
+	// kept between frames so rendering stops allocating once the first frame has sized them, which also means a tracer
+	// renders one frame at a time; frame_ holds the image sized buffers
+	mutable std::vector<std::unique_ptr<worker_memory>> workers_;
+	mutable arena frame_;
+	vec3 eye_;
+	vec3 corner_;
+	vec3 horizontal_;
+	vec3 vertical_;
+
+	// the eye is the camera's position and the image is whatever of the scene shows through the projection plane
+	void look()
+	{
+		this->eye_ = this->camera_->get_position();
+		this->corner_ = this->projection_plane_->get_corner(0, 0);
+		this->horizontal_ = this->projection_plane_->get_corner(1, 0) - this->corner_;
+		this->vertical_ = this->projection_plane_->get_corner(0, 1) - this->corner_;
+	}
+
+	template <typename primitive>
+	static bool intersect_tree(const std::vector<primitive>& primitives, const bvh& tree, const ray& r, intersection& record)
+	{
+		return tree.intersect(r, record, [&primitives](const int first, const int count, const ray& leaf_ray, intersection& leaf_record)
+		{
+			auto found = false;
+			for (auto i = first; i < first + count; i++)
+			{
+				found |= primitives[i].intersect(leaf_ray, leaf_record);
+			}
+			return found;
+		});
+	}
+
+	// makes sure every thread the scheduler may start has its memory
+	void prepare_workers(const unsigned threads) const
+	{
+		const auto count = size_t(threads == 0 ? tile_scheduler::default_threads() : threads);
+		while (this->workers_.size() < count)
+		{
+			this->workers_.emplace_back(new worker_memory());
+		}
+	}
+
+	void collect_spheres()
+	{
+		this->spheres_.clear();
+		for (const auto ball : this->sphere_sources_)
+		{
+			this->spheres_.emplace_back(ball->get_centre(), ball->get_radius(), ball->get_material());
+		}
+	}
+
+	// traces 8 neighbouring primary rays together through both hierarchies
+	void intersect_packet(ray_packet& packet) const
+	{
+		const auto& kernels = active_kernels();
+		const auto test_node = [&kernels](const ray_packet& leaf_packet, const bvh_node& node)
+		{
+			return kernels.intersect_packet_box(leaf_packet, node);
+		};
+		this->sphere_tree_.intersect_packet(packet, test_node, [this, &kernels](const int first, const int count, ray_packet& leaf_packet)
+		{
+			PROFILE_COUNT(sphere_tests, count);
+			for (auto i = first; i < first + count; i++)
+			{
+				kernels.intersect_packet_sphere(leaf_packet, this->spheres_[i], i);
+			}
+		});
+		this->instance_tree_.intersect_packet(packet, test_node, [this, &kernels](const int first, const int count, ray_packet& leaf_packet)
+		{
+			for (auto i = first; i < first + count; i++)
+			{
+				this->instances_[i].intersect_packet(leaf_packet, i, kernels);
+			}
+		});
+	}
+
+	// the hit record of a packet lane, left empty when the lane found nothing
+	void fill_hit(const ray_packet& packet, const int lane, const ray& r, intersection& record) const
+	{
+		if (packet.triangle[lane] >= 0)
+		{
+			this->instances_[packet.instance[lane]].fill(r, packet.triangle[lane], packet.distance[lane], packet.u[lane], packet.v[lane], record);
+		}
+		else if (packet.sphere[lane] >= 0)
+		{
+			this->spheres_[packet.sphere[lane]].fill(r, packet.distance[lane], record);
+		}
+	}
+
+	static unsigned hash(unsigned value)
+	{
+		value ^= value >> 16;
+		value *= 0x7feb352du;
+		value ^= value >> 15;
+		value *= 0x846ca68bu;
+		value ^= value >> 16;
+		return value;
+	}
+
+	static float radical_inverse(unsigned index, const unsigned base)
+	{
+		const auto inverse_base = 1.0f / float(base);
+		auto fraction = inverse_base;
+		auto result = 0.0f;
+		while (index > 0)
+		{
+			result += fraction * float(index % base);
+			index /= base;
+			fraction *= inverse_base;
+		}
+		return result;
+	}
+
+	// next number in [0, 1) of a path's random sequence
+	static float next_random(unsigned& seed)
+	{
+		seed = hash(seed + 0x9e3779b9u);
+		return float(seed >> 8) / 16777216.0f;
+	}
+
+	static float max_component(const vec3 value)
+	{
+		return max(value.x, max(value.y, value.z));
+	}
+
+	// one reflected or refracted branch worth amount of the surface; branches cut by the depth or contribution limits are
+	// replaced by the surface's own shading, branches dropped by russian roulette count as black and the survivors make up for them
+	vec3 follow(const ray& next, const float amount, const vec3 color, const vec3 local, const vec3 light_position, path_state& path) const
+	{
+		// every branch draws from its own sequence
+		path.seed = hash(path.seed + 1u);
+		const auto weight = path.weight * color * amount;
+		if (path.depth >= this->limits_.max_depth || max_component(weight) < this->limits_.min_contribution)
+		{
+			return amount * local;
+		}
+		auto branch = path_state{ path.depth + 1, weight, path.seed };
+		auto survival = 1.0f;
+		if (path.depth >= this->limits_.roulette_depth)
+		{
+			survival = min(1.0f, max_component(weight) / this->limits_.roulette_weight);
+			if (next_random(branch.seed) >= survival)
+			{
+				return vec3(0.0f);
+			}
+			branch.weight /= survival;
+		}
+		return color * amount * this->trace(next, light_position, branch) / survival;
+	}
+
+	// Halton (2, 3) points shifted by a per pixel rotation; sample 0 is always the pixel centre so 1 spp matches the old output
+	static vec2 sample_offset(const int x, const int y, const int sample)
+	{
+		if (sample == 0)
+		{
+			return vec2(0.5f, 0.5f);
+		}
+		const auto seed = hash(unsigned(x) * 73856093u ^ unsigned(y) * 19349663u);
+		const auto shift_x = float(seed & 0xffffu) / 65536.0f;
+		const auto shift_y = float(seed >> 16) / 65536.0f;
+		const auto u = radical_inverse(unsigned(sample), 2) + shift_x;
+		const auto v = radical_inverse(unsigned(sample), 3) + shift_y;
+		return vec2(u - floor(u), v - floor(v));
+	}
+
+	// traces sample[lane] of each of the packet_width pixels starting at (x, y) into colors[lane], and what its primary ray hit
+	// into seen[lane] unless seen is null; lanes with a negative sample number are left out and keep their color
+	void trace_samples(const int x, const int y, const int* samples, const float width, const float height, const vec3 light_position, vec3* colors,
+		pixel_features* seen = nullptr) const
+	{
+		ray_packet packet;
+		packet.mean_direction = vec3(0.0f);
+		auto lanes = 0;
+		for (auto lane = 0; lane < packet_width; lane++)
+		{
+			if (samples[lane] < 0)
+			{
+				packet.disable(lane);
+				continue;
+			}
+			const auto offset = sample_offset(x + lane, y, samples[lane]);
+			const auto primary = this->camera_ray((x + lane + offset.x) / width, (y + offset.y) / height);
+			packet.set(lane, primary);
+			packet.mean_direction += primary.direction;
+			lanes++;
+		}
+		PROFILE_COUNT(samples, lanes);
+		PROFILE_COUNT(rays, lanes);
+		this->intersect_packet(packet);
+
+		for (auto lane = 0; lane < packet_width; lane++)
+		{
+			if (samples[lane] < 0)
+			{
+				continue;
+			}
+			const auto r = packet.get_ray(lane);
+			auto record = intersection();
+			this->fill_hit(packet, lane, r, record);
+			colors[lane] = vec3(0.0f);
+			if (seen != nullptr)
+			{
+				seen[lane] = record.surface == nullptr ? pixel_features{ vec3(0.0f), vec3(0.0f), 0.0f, 0.0f }
+					: pixel_features{ record.normal, record.surface->dye(), record.distance, 0.0f };
+			}
+			if (record.surface != nullptr)
+			{
+				auto path = path_state{ 0, vec3(1.0f), hash(unsigned(x + lane) * 73856093u ^ unsigned(y) * 19349663u ^ unsigned(samples[lane]) * 83492791u) };
+				colors[lane] = this->scatter(r, record, light_position, path);
+			}
+		}
+	}
+
+	// adds samples [first_sample, last_sample) of every pixel in the tile to the running sums and writes the averages out;
+	// the features the samples saw are summed into features unless it is null, with the squares of their luminances in
+	// place of the variance
+	void render_tile(const tile& region, image* target, vec3* sums, const int first_sample, const int last_sample, const vec3 light_position,
+		pixel_features* features = nullptr) const
+	{
+		PROFILE_SCOPE("tile");
+		const auto width = float(target->get_width());
+		const auto height = float(target->get_height());
+		int samples[packet_width];
+		vec3 colors[packet_width];
+		pixel_features seen[packet_width];
+		for (auto y = region.y; y < region.y + region.height; y++)
+		{
+			for (auto x = region.x; x < region.x + region.width; x += packet_width)
+			{
+				const auto lanes = std::min(packet_width, region.x + region.width - x);
+				for (auto sample = first_sample; sample < last_sample; sample++)
+				{
+					for (auto lane = 0; lane < packet_width; lane++)
+					{
+						samples[lane] = lane < lanes ? sample : -1;
+					}
+					this->trace_samples(x, y, samples, width, height, light_position, colors, features == nullptr ? nullptr : seen);
+					for (auto lane = 0; lane < lanes; lane++)
+					{
+						sums[y * target->get_width() + x + lane] += colors[lane];
+					}
+					if (features != nullptr)
+					{
+						for (auto lane = 0; lane < lanes; lane++)
+						{
+							auto& sum = features[y * target->get_width() + x + lane];
+							sum.normal += seen[lane].normal;
+							sum.albedo += seen[lane].albedo;
+							sum.depth += seen[lane].depth;
+							const auto luminance = dot(colors[lane], vec3(0.2126f, 0.7152f, 0.0722f));
+							sum.variance += luminance * luminance;
+						}
+					}
+				}
+				for (auto lane = 0; lane < lanes; lane++)
+				{
+					target->set_pixel(x + lane, y, sums[y * target->get_width() + x + lane] / float(last_sample));
+				}
+			}
+		}
+	}
+
+	// samples the tile in rounds until every pixel's estimate has settled or reached the sample limit; returns the samples taken
+	size_t render_tile_adaptive(const tile& region, image* target, const sampling_limits& limits, const vec3 light_position, arena& frame) const
+	{
+		PROFILE_SCOPE("adaptive tile");
+		const auto width = float(target->get_width());
+		const auto height = float(target->get_height());
+		const auto pixels = size_t(region.width) * region.height;
+		frame.reset();
+		const auto sums = frame.make_array(pixels, vec3(0.0f));
+		// mean and squared deviation sum of each pixel's luminance, updated as in Welford's method
+		const auto means = frame.make_array(pixels, 0.0f);
+		const auto deviations = frame.make_array(pixels, 0.0f);
+		const auto counts = frame.make_array(pixels, 0);
+		const auto wanted = frame.make_array(pixels, char(1));
+		const auto unsettled = frame.make_array(pixels, char(0));
+		auto total = size_t(0);
+		int samples[packet_width];
+		vec3 colors[packet_width];
+		for (auto round = 0;; round++)
+		{
+			const auto round_samples = round == 0 ? limits.min_samples : limits.batch;
+			auto active = false;
+			for (auto y = 0; y < region.height; y++)
+			{
+				for (auto x = 0; x < region.width; x += packet_width)
+				{
+					for (auto sample = 0; sample < round_samples; sample++)
+					{
+						auto any = false;
+						for (auto lane = 0; lane < packet_width; lane++)
+						{
+							const auto index = y * region.width + x + lane;
+							const auto take = x + lane < region.width && wanted[index] != 0 && counts[index] < limits.max_samples;
+							samples[lane] = take ? counts[index] : -1;
+							any |= take;
+						}
+						if (!any)
+						{
+							break;
+						}
+						this->trace_samples(region.x + x, region.y + y, samples, width, height, light_position, colors);
+						for (auto lane = 0; lane < packet_width; lane++)
+						{
+							if (samples[lane] < 0)
+							{
+								continue;
+							}
+							const auto index = y * region.width + x + lane;
+							const auto luminance = dot(colors[lane], vec3(0.2126f, 0.7152f, 0.0722f));
+							counts[index]++;
+							sums[index] += colors[lane];
+							const auto delta = luminance - means[index];
+							means[index] += delta / float(counts[index]);
+							deviations[index] += delta * (luminance - means[index]);
+							total++;
+						}
+					}
+				}
+			}
+
+			// a pixel has settled once the standard error of its mean is below threshold times its brightness; dark pixels are
+			// held to the error of a 10% grey so they do not chase noise nobody can see
+			for (auto index = size_t(0); index < pixels; index++)
+			{
+				const auto count = float(counts[index]);
+				const auto error = count > 1.0f ? sqrt(deviations[index] / (count - 1.0f) / count) : FLT_MAX;
+				unsettled[index] = counts[index] < limits.max_samples && error > limits.threshold * max(means[index], 0.1f) ? 1 : 0;
+			}
+			// a few samples can agree by chance next to an edge, so unsettled pixels keep their neighbours sampling too
+			for (auto y = 0; y < region.height; y++)
+			{
+				for (auto x = 0; x < region.width; x++)
+				{
+					auto needed = false;
+					for (auto near_y = max(0, y - 1); near_y <= min(region.height - 1, y + 1); near_y++)
+					{
+						for (auto near_x = max(0, x - 1); near_x <= min(region.width - 1, x + 1); near_x++)
+						{
+							needed |= unsettled[near_y * region.width + near_x] != 0;
+						}
+					}
+					const auto index = y * region.width + x;
+					wanted[index] = needed && counts[index] < limits.max_samples ? 1 : 0;
+					active |= wanted[index] != 0;
+				}
+			}
+			if (!active)
+			{
+				break;
+			}
+		}
+
+		for (auto y = 0; y < region.height; y++)
+		{
+			for (auto x = 0; x < region.width; x++)
+			{
+				const auto index = y * region.width + x;
+				target->set_pixel(region.x + x, region.y + y, sums[index] / float(max(counts[index], 1)));
+			}
+		}
+		return total;
+	}
+
+	// closest hits of every queued ray, 8 at a time through the packet kernels
+	void intersect_queue(const ray_queue& queue, std::vector<intersection>& hits) const
+	{
+		PROFILE_COUNT(rays, queue.size());
+		hits.assign(queue.size(), intersection());
+		ray_packet packet;
+		for (auto first = size_t(0); first < queue.size(); first += packet_width)
+		{
+			const auto lanes = int(std::min(size_t(packet_width), queue.size() - first));
+			packet.mean_direction = vec3(0.0f);
+			for (auto lane = 0; lane < packet_width; lane++)
+			{
+				if (lane >= lanes)
+				{
+					packet.disable(lane);
+					continue;
+				}
+				const auto r = queue.get_ray(first + lane);
+				packet.set(lane, r);
+				packet.mean_direction += r.direction;
+			}
+			this->intersect_packet(packet);
+			for (auto lane = 0; lane < lanes; lane++)
+			{
+				this->fill_hit(packet, lane, queue.get_ray(first + lane), hits[first + lane]);
+			}
+		}
+	}
+
+	// shades the hit of queued ray index at the given depth: ambient light goes straight to its pixel, diffuse and specular
+	// light waits in the shadow queue and the branches that are followed go to the next queue, with the same limits as follow()
+	void shade_queued(wavefront_state& state, const size_t index, const int depth, const vec3 light_position) const
+	{
+		const auto r = state.current.get_ray(index);
+		const auto& record = state.hits[index];
+		const auto weight = state.current.get_weight(index);
+		const auto pixel = state.current.pixel[index];
+		auto seed = state.current.seed[index];
+
+		bounce bounces[2];
+		const auto count = this->get_bounces(r, record, bounces);
+		// how much of the surface's own shading reaches the pixel, including the branches cut short
+		auto share = count == 0 ? 1.0f : record.surface->absorb();
+		const auto color = record.surface->dye();
+		for (auto i = 0; i < count; i++)
+		{
+			seed = hash(seed + 1u);
+			const auto branch_weight = weight * color * bounces[i].amount;
+			if (depth >= this->limits_.max_depth || max_component(branch_weight) < this->limits_.min_contribution)
+			{
+				share += bounces[i].amount;
+				continue;
+			}
+			auto branch_seed = seed;
+			auto survival = 1.0f;
+			if (depth >= this->limits_.roulette_depth)
+			{
+				survival = min(1.0f, max_component(branch_weight) / this->limits_.roulette_weight);
+				if (next_random(branch_seed) >= survival)
+				{
+					continue;
+				}
+			}
+			state.next.push(bounces[i].origin, bounces[i].direction, branch_weight / survival, pixel, branch_seed);
+		}
+
+		const auto lighting = this->get_lighting(r, record, light_position);
+		state.sums[pixel] += weight * share * lighting.ambient;
+		const auto direct = weight * share * (lighting.diffuse + lighting.specular);
+		if (lighting.faces_light)
+		{
+			state.shadows.push(lighting.shadow_origin, lighting.light_direction, lighting.light_distance, direct, pixel);
+		}
+		else
+		{
+			state.sums[pixel] += direct;
+		}
+	}
+
+	// every sample of the tile goes through the queues together: intersect the whole queue, shade its hits grouped by material
+	// so each material's code and data stay in cache, test the shadow rays, and carry on with the compacted secondary rays
+	void render_tile_wavefront(const tile& region, image* target, const int samples, const vec3 light_position, worker_memory& memory) const
+	{
+		PROFILE_SCOPE("wavefront tile");
+		PROFILE_COUNT(samples, size_t(region.width) * region.height * samples);
+		const auto width = float(target->get_width());
+		const auto height = float(target->get_height());
+		auto& state = memory.wavefront;
+		state.current.clear();
+		memory.frame.reset();
+		state.sums = memory.frame.make_array(size_t(region.width) * region.height, vec3(0.0f));
+		for (auto y = region.y; y < region.y + region.height; y++)
+		{
+			for (auto x = region.x; x < region.x + region.width; x++)
+			{
+				const auto pixel = (y - region.y) * region.width + x - region.x;
+				for (auto sample = 0; sample < samples; sample++)
+				{
+					const auto offset = sample_offset(x, y, sample);
+					const auto primary = this->camera_ray((x + offset.x) / width, (y + offset.y) / height);
+					const auto seed = hash(unsigned(x) * 73856093u ^ unsigned(y) * 19349663u ^ unsigned(sample) * 83492791u);
+					state.current.push(primary.origin, primary.direction, vec3(1.0f), pixel, seed);
+				}
+			}
+		}
+
+		for (auto depth = 0; state.current.size() > 0; depth++)
+		{
+			{
+				PROFILE_SCOPE("intersect");
+				this->intersect_queue(state.current, state.hits);
+			}
+			{
+				PROFILE_SCOPE("shade");
+				state.order.clear();
+				for (auto i = size_t(0); i < state.hits.size(); i++)
+				{
+					if (state.hits[i].surface != nullptr)
+					{
+						state.order.push_back(int(i));
+					}
+				}
+				const auto& hits = state.hits;
+				std::sort(state.order.begin(), state.order.end(), [&hits](const int a, const int b)
+				{
+					return std::less<const material*>()(hits[a].surface, hits[b].surface) || (hits[a].surface == hits[b].surface && a < b);
+				});
+
+				state.next.clear();
+				state.shadows.clear();
+				for (const auto index : state.order)
+				{
+					this->shade_queued(state, size_t(index), depth, light_position);
+				}
+			}
+			{
+				PROFILE_SCOPE("shadows");
+				for (auto i = size_t(0); i < state.shadows.size(); i++)
+				{
+					if (!this->occluded(state.shadows.get_ray(i), state.shadows.distance[i]))
+					{
+						state.sums[state.shadows.pixel[i]] += state.shadows.get_light(i);
+					}
+				}
+			}
+			std::swap(state.current, state.next);
+		}
+
+		for (auto y = 0; y < region.height; y++)
+		{
+			for (auto x = 0; x < region.width; x++)
+			{
+				target->set_pixel(region.x + x, region.y + y, state.sums[y * region.width + x] / float(samples));
+			}
+		}
+	}
+
+public:
+	tracer(const camera* cam, const wall* projection_plane, const light* lamp) : camera_(cam), projection_plane_(projection_plane), light_(lamp)
+	{
+		this->look();
+	}
+
+	void set_limits(const trace_limits& limits)
+	{
+		this->limits_ = limits;
+	}
+
+	// u runs left to right and v top to bottom across the image, both in [0, 1]
+	ray camera_ray(const float u, const float v) const
+	{
+		// the plane's corner (0, 0) is its bottom left
+		const auto on_plane = this->corner_ + u * this->horizontal_ + (1.0f - v) * this->vertical_;
+		return ray(this->eye_, normalize(on_plane - this->eye_));
+	}
+
+	// triangles stored once per unique mesh, however many instances use them
+	int get_triangle_count() const
+	{
+		auto count = 0;
+		for (const auto& entry : this->meshes_)
+		{
+			count += entry.second->get_triangle_count();
+		}
+		return count;
+	}
+
+	int get_instance_count() const
+	{
+		return int(this->instances_.size());
+	}
+
+	int get_sphere_count() const
+	{
+		return int(this->spheres_.size());
+	}
+
+	// bytes held by the primitives and hierarchies, not counting the shapes they were built from
+	size_t get_memory_usage() const
+	{
+		auto bytes = this->instances_.capacity() * sizeof(instance)
+			+ this->spheres_.capacity() * sizeof(sphere_primitive)
+			+ this->instance_tree_.get_memory_usage()
+			+ this->sphere_tree_.get_memory_usage();
+		for (const auto& entry : this->meshes_)
+		{
+			bytes += entry.second->get_memory_usage();
+		}
+		return bytes;
+	}
+
+	// round spheres are intersected analytically, every other shape becomes an instance of its mesh
+	void add(const shape* item)
+	{
+		const auto ball = dynamic_cast<const sphere*>(item);
+		if (ball != nullptr && ball->is_round())
+		{
+			this->sphere_sources_.push_back(ball);
+			return;
+		}
+
+		const auto geometry = item->get_mesh();
+		auto& bottom = this->meshes_[geometry];
+		if (!bottom)
+		{
+			bottom.reset(new mesh_bvh(geometry));
+		}
+		this->instances_.emplace_back(bottom.get(), item);
+	}
+
+	// must be called after the last add() and before rendering
+	void build()
+	{
+		this->collect_spheres();
+		build_tree(this->spheres_, this->sphere_tree_);
+		reorder(this->sphere_sources_, this->sphere_tree_);
+		build_tree(this->instances_, this->instance_tree_);
+	}
+
+	// picks up a moved camera and moved shapes: instances whose model matrix changed are placed again and both top levels
+	// are refitted, with only their degraded subtrees rebuilt; the mesh hierarchies are kept as they are. Spheres have to
+	// stay round
+	void update()
+	{
+		PROFILE_SCOPE("update tracer");
+		this->look();
+		for (auto& item : this->instances_)
+		{
+			const auto& model = item.source->get_model();
+			if (model != item.model)
+			{
+				item.place(model);
+			}
+		}
+		this->collect_spheres();
+		if (refit_tree(this->spheres_, this->sphere_tree_))
+		{
+			reorder(this->sphere_sources_, this->sphere_tree_);
+		}
+		refit_tree(this->instances_, this->instance_tree_);
+	}
+
+	bool intersect(const ray& r, intersection& record) const
+	{
+		PROFILE_COUNT(rays, 1);
+		const auto hit_sphere = this->sphere_tree_.intersect(r, record, [this](const int first, const int count, const ray& leaf_ray, intersection& leaf_record)
+		{
+			PROFILE_COUNT(sphere_tests, count);
+			auto found = false;
+			for (auto i = first; i < first + count; i++)
+			{
+				found |= this->spheres_[i].intersect(leaf_ray, leaf_record);
+			}
+			return found;
+		});
+		const auto hit_instance = intersect_tree(this->instances_, this->instance_tree_, r, record);
+		return hit_sphere || hit_instance;
+	}
+
+	// shadow ray query: true as soon as anything is found closer than max_distance, no hit record is built
+	bool occluded(const ray& r, const float max_distance) const
+	{
+		PROFILE_COUNT(shadow_rays, 1);
+		const auto blocked_by_sphere = this->sphere_tree_.occluded(r, max_distance, [this, max_distance](const int first, const int count, const ray& leaf_ray)
+		{
+			PROFILE_COUNT(sphere_tests, count);
+			for (auto i = first; i < first + count; i++)
+			{
+				if (this->spheres_[i].occludes(leaf_ray, max_distance))
+				{
+					return true;
+				}
+			}
+			return false;
+		});
+		return blocked_by_sphere || this->instance_tree_.occluded(r, max_distance, [this, max_distance](const int first, const int count, const ray& leaf_ray)
+		{
+			for (auto i = first; i < first + count; i++)
+			{
+				if (this->instances_[i].occludes(leaf_ray, max_distance))
+				{
+					return true;
+				}
+			}
+			return false;
+		});
+	}
+
+	vec3 trace(const ray& r, const vec3 light_position) const
+	{
+		auto path = path_state{ 0, vec3(1.0f), 0u };
+		return this->trace(r, light_position, path);
+	}
+
+	vec3 trace(const ray& r, const vec3 light_position, path_state& path) const
+	{
+		auto record = intersection();
+		if (!this->intersect(r, record))
+		{
+			return vec3(0.0f);
+		}
+		return this->scatter(r, record, light_position, path);
+	}
+
+	// the surface's own shading weighted by absorb(), plus reflected and refracted rays weighted by reflect() and refract()
+	// and tinted by its color
+	vec3 scatter(const ray& r, const intersection& record, const vec3 light_position, path_state& path) const
+	{
+		const auto local = this->shade(r, record, light_position);
+		bounce bounces[2];
+		const auto count = this->get_bounces(r, record, bounces);
+		if (count == 0)
+		{
+			return local;
+		}
+
+		const auto color = record.surface->dye();
+		auto result = record.surface->absorb() * local;
+		for (auto i = 0; i < count; i++)
+		{
+			result += this->follow(ray(bounces[i].origin, bounces[i].direction), bounces[i].amount, color, local, light_position, path);
+		}
+		return result;
+	}
+
+	// the reflected and then the refracted ray of a hit, leaving out those the material gives no share; returns how many
+	int get_bounces(const ray& r, const intersection& record, bounce* bounces) const
+	{
+		const auto surface = record.surface;
+		auto reflection = surface->reflect();
+		auto refraction = surface->refract();
+		if (reflection <= 0.0f && refraction <= 0.0f)
+		{
+			return 0;
+		}
+
+		const auto entering = dot(record.normal, r.direction) < 0.0f;
+		const auto norm = entering ? record.normal : -record.normal;
+		auto refracted = vec3(0.0f);
+		if (refraction > 0.0f)
+		{
+			refracted = refract(r.direction, norm, entering ? 1.0f / glass_index : glass_index);
+			// total internal reflection sends everything back
+			if (refracted == vec3(0.0f))
+			{
+				reflection += refraction;
+				refraction = 0.0f;
+			}
+		}
+		auto count = 0;
+		if (reflection > 0.0f)
+		{
+			bounces[count++] = bounce{ reflection, record.position + ray_epsilon * norm, reflect(r.direction, norm) };
+		}
+		if (refraction > 0.0f)
+		{
+			bounces[count++] = bounce{ refraction, record.position - ray_epsilon * norm, normalize(refracted) };
+		}
+		return count;
+	}
+
+	surface_light get_lighting(const ray& r, const intersection& record, const vec3 light_position) const
+	{
+		const auto props = this->light_->get_properties();
+		const auto color = record.surface->dye();
+		// surfaces are single sided meshes, light whichever side the ray sees
+		const auto norm = dot(record.normal, r.direction) > 0.0f ? -record.normal : record.normal;
+
+		auto lighting = surface_light();
+		lighting.ambient = props->ambient_color * color;
+
+		const auto to_light = light_position - record.position;
+		lighting.light_distance = length(to_light);
+		lighting.light_direction = to_light / lighting.light_distance;
+		lighting.shadow_origin = record.position + ray_epsilon * norm;
+		const auto diff = max(dot(norm, lighting.light_direction), 0.0f);
+		lighting.faces_light = diff > 0.0f;
+		lighting.diffuse = props->diffusion_color * (color * diff);
+
+		const auto view_direction = -r.direction;
+		const auto reflect_direction = reflect(-lighting.light_direction, norm);
+		const auto spec = pow(max(dot(view_direction, reflect_direction), 0.0f), 128.0f);
+		lighting.specular = props->specular_color * (vec3(0.5f) * spec);
+		return lighting;
+	}
+
+	// phong lighting of the surface alone; only ambient light reaches it when something lies between it and the light
+	vec3 shade(const ray& r, const intersection& record, const vec3 light_position) const
+	{
+		const auto lighting = this->get_lighting(r, record, light_position);
+		if (lighting.faces_light && this->occluded(ray(lighting.shadow_origin, lighting.light_direction), lighting.light_distance))
+		{
+			return lighting.ambient;
+		}
+		return lighting.ambient + lighting.diffuse + lighting.specular;
+	}
+
+	// renders in passes that raise the samples per pixel to each entry of passes in turn, e.g. { 1, 4, 16 };
+	// every finished tile is written to the image straight away, so it always holds a complete, if noisy, picture.
+	// features, when given, gets one entry per pixel of what the samples hit first, complete once the last pass is done
+	void render_progressive(image* target, const std::vector<int>& passes, const std::function<void(int)>& on_pass, const unsigned threads = 0,
+		pixel_features* features = nullptr) const
+	{
+		const auto pixels = size_t(target->get_width()) * target->get_height();
+		this->frame_.reset();
+		const auto sums = this->frame_.make_array(pixels, vec3(0.0f));
+		if (features != nullptr)
+		{
+			std::fill_n(features, pixels, pixel_features{ vec3(0.0f), vec3(0.0f), 0.0f, 0.0f });
+		}
+		auto samples = 0;
+		for (const auto pass : passes)
+		{
+			if (pass <= samples)
+			{
+				continue;
+			}
+			this->render_pass(target, sums, samples, pass, threads, features);
+			samples = pass;
+			if (on_pass)
+			{
+				on_pass(samples);
+			}
+		}
+		if (features != nullptr && samples > 0)
+		{
+			for (auto i = size_t(0); i < pixels; i++)
+			{
+				features[i].normal /= float(samples);
+				features[i].albedo /= float(samples);
+				features[i].depth /= float(samples);
+				const auto mean = dot(sums[i], vec3(0.2126f, 0.7152f, 0.0722f)) / float(samples);
+				// the spread of the samples over samples - 1, and over samples again for the variance of their mean
+				features[i].variance = samples > 1 ? max(features[i].variance / float(samples) - mean * mean, 0.0f) / float(samples - 1) : 0.0f;
+			}
+		}
+	}
+
+	// adds samples [first_sample, last_sample) of every pixel to sums, one vec3 per pixel in row order, and writes the
+	// averages to target; the caller keeps the sums, so it decides how long they keep accumulating. The same goes for
+	// features, which are only traced when it is given
+	void render_pass(image* target, vec3* sums, const int first_sample, const int last_sample, const unsigned threads = 0,
+		pixel_features* features = nullptr) const
+	{
+		auto scheduler = tile_scheduler(target->get_width(), target->get_height());
+		const auto light_position = this->light_->get_location();
+		scheduler.run(threads, [&](const tile& region, unsigned)
+		{
+			this->render_tile(region, target, sums, first_sample, last_sample, light_position, features);
+		});
+	}
+
+	// renders samples [0, samples) of just the pixels in regions, which the threads share tile by tile so that a few small
+	// regions still keep every thread busy; sums holds one vec3 per pixel of target and has to be zero across the regions
+	void render_regions(const std::vector<tile>& regions, image* target, vec3* sums, const int samples, const unsigned threads = 0) const
+	{
+		auto scheduler = tile_scheduler(regions);
+		const auto light_position = this->light_->get_location();
+		scheduler.run(threads, [&](const tile& part, unsigned)
+		{
+			this->render_tile(part, target, sums, 0, samples, light_position);
+		});
+	}
+
+	// spends samples where the estimate is still noisy: every pixel gets min_samples, then pixels whose error is above the
+	// threshold, and their neighbours, get batch more per round up to max_samples; returns the average samples per pixel
+	double render_adaptive(image* target, const sampling_limits& limits, const unsigned threads = 0) const
+	{
+		auto scheduler = tile_scheduler(target->get_width(), target->get_height());
+		const auto light_position = this->light_->get_location();
+		this->prepare_workers(threads);
+		for (auto& memory : this->workers_)
+		{
+			memory->samples = 0;
+		}
+		scheduler.run(threads, [&](const tile& region, const unsigned worker)
+		{
+			auto& memory = *this->workers_[worker];
+			memory.samples += this->render_tile_adaptive(region, target, limits, light_position, memory.frame);
+		});
+		auto total = size_t(0);
+		for (const auto& memory : this->workers_)
+		{
+			total += memory->samples;
+		}
+		return double(total) / (double(target->get_width()) * target->get_height());
+	}
+
+	// the same image as render() up to rounding, traced breadth first
+	void render_wavefront(image* target, const unsigned threads = 0, const int samples = 1) const
+	{
+		auto scheduler = tile_scheduler(target->get_width(), target->get_height());
+		const auto light_position = this->light_->get_location();
+		this->prepare_workers(threads);
+		scheduler.run(threads, [&](const tile& region, const unsigned worker)
+		{
+			this->render_tile_wavefront(region, target, samples, light_position, *this->workers_[worker]);
+		});
+	}
+
+	// features, when given, gets one entry per pixel
+	void render(image* target, const unsigned threads = 0, const int samples = 1, pixel_features* features = nullptr) const
+	{
+		this->render_progressive(target, { samples }, nullptr, threads, features);
+	}
+};
+
+// a tracer over every shape in the scene, ready to render
+inline tracer* open_tracer(const scene* world, const trace_limits& limits)
+{
+	PROFILE_SCOPE("build tracer");
+	const auto renderer = new tracer(world->cam, world->projection_plane, world->lamp);
+	renderer->set_limits(limits);
+	for (auto item : world->shapes)
+	{
+		renderer->add(item);
+	}
+	renderer->build();
+	return renderer;
+}
+#endif